@@ -6,6 +6,8 @@
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
+    // loads while the window is created - the QML instance below picks the model up from the registry
+    SpeechToText::preloadModel("ggml-tiny.bin");
 
     QQmlApplicationEngine engine;
 
@@ -135,6 +135,8 @@ ApplicationWindow {
 
   SpeechToText {
     id: stt
+    // set before the model path - loading starts as soon as the path is set
+    warmUp: true
     modelPath: "ggml-tiny.bin"
     onResultReady: function (r) {
       result.text = r
@@ -0,0 +1,198 @@
+#include "AudioConverter.h"
+#include "audiokernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <numeric>
+
+namespace {
+/// Taps per phase for every (rounded up) input samples per output sample
+constexpr size_t TAPS_PER_RATIO = 24;
+/// Passband edge as a fraction of the lower of the two sample rates
+constexpr double CUTOFF = 0.45;
+/// Kaiser window shape - about 60 dB stopband attenuation
+constexpr double KAISER_BETA = 6.0;
+
+/// Zeroth order modified Bessel function of the first kind
+double bessel_i0(double x)
+{
+    double sum  = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum  += term;
+    }
+    return sum;
+}
+} // namespace
+
+AudioConverter::AudioConverter(const QAudioFormat &input, int outputRate)
+    : _input{input}, _outputRate{outputRate}
+{
+    Q_ASSERT(static_cast<size_t>(input.bytesPerFrame()) <= _partial.size());
+    designFilter();
+    reset();
+}
+
+void AudioConverter::designFilter()
+{
+    const int rate = _input.sampleRate();
+    const int gcd  = std::gcd(rate, _outputRate);
+    _up   = _outputRate / gcd;
+    _down = rate / gcd;
+    if (_up == _down) {
+        _taps = 0;
+        return;
+    }
+
+    // downsampling needs a longer filter - it spans more input samples for the same transition band
+    const size_t ratio = std::max(1, (rate + _outputRate - 1) / _outputRate);
+    _taps = (TAPS_PER_RATIO * ratio + qtw::RESAMPLE_LANES - 1) / qtw::RESAMPLE_LANES * qtw::RESAMPLE_LANES;
+
+    // Kaiser windowed sinc at the upsampled rate, split into _up phases of _taps coefficients
+    const size_t n      = _taps * _up;
+    const double cutoff = CUTOFF * std::min(rate, _outputRate) / (static_cast<double>(rate) * _up);
+    const double center = (n - 1) / 2.0;
+    const double i0     = bessel_i0(KAISER_BETA);
+    auto prototype = [&](size_t k){
+        const double x    = k - center;
+        const double sinc = x == 0 ? 2 * cutoff : std::sin(2 * std::numbers::pi * cutoff * x) / (std::numbers::pi * x);
+        const double r    = 2.0 * k / (n - 1) - 1.0;
+        return sinc * bessel_i0(KAISER_BETA * std::sqrt(std::max(0.0, 1.0 - r * r))) / i0;
+    };
+
+    _filters.assign(_taps * _up, 0.0f);
+    for (int p = 0; p < _up; p++) {
+        auto filter = _filters.begin() + p * _taps;
+        double sum  = 0;
+        for (size_t k = 0; k < _taps; k++) {
+            const auto h = prototype(p + k * _up);
+            filter[_taps - 1 - k] = static_cast<float>(h);
+            sum += h;
+        }
+        // unity gain in every phase - no ripple at DC from the phase split
+        for (size_t k = 0; k < _taps && sum != 0; k++) {
+            filter[k] = static_cast<float>(filter[k] / sum);
+        }
+    }
+} // AudioConverter::designFilter
+
+size_t AudioConverter::maxOutput(size_t inputBytes) const
+{
+    const auto frames = (inputBytes + _partialSize) / _input.bytesPerFrame();
+    if (_taps == 0) {
+        return frames;
+    }
+    return frames * _up / _down + 2;
+}
+
+size_t AudioConverter::convert(std::span<const char> input, std::span<float> output)
+{
+    const size_t frame_size = _input.bytesPerFrame();
+    // same rate - the samples are only downmixed, straight into the output
+    float *direct = _taps == 0 ? output.data() : nullptr;
+    size_t frames = 0;
+
+    auto append = [&](const char *data, size_t count){
+        if (direct) {
+            Q_ASSERT(frames + count <= output.size());
+            downmixInto(data, count, direct + frames);
+        } else {
+            const auto offset = _buffer.size();
+            // only grows - no allocation once the largest block went through
+            _buffer.resize(offset + count);
+            downmixInto(data, count, _buffer.data() + offset);
+        }
+        frames += count;
+    };
+
+    // complete the frame split by the previous call
+    if (_partialSize > 0) {
+        const auto n = std::min(frame_size - _partialSize, input.size());
+        std::memcpy(_partial.data() + _partialSize, input.data(), n);
+        _partialSize += n;
+        input = input.subspan(n);
+        if (_partialSize < frame_size) {
+            return 0;
+        }
+        append(_partial.data(), 1);
+        _partialSize = 0;
+    }
+
+    const auto whole = input.size() / frame_size;
+    append(input.data(), whole);
+
+    // keep the trailing partial frame
+    _partialSize = input.size() - whole * frame_size;
+    std::memcpy(_partial.data(), input.data() + whole * frame_size, _partialSize);
+
+    if (direct) {
+        return frames;
+    }
+    return resample(output.data());
+}
+
+size_t AudioConverter::resample(float *output)
+{
+    const size_t size = _buffer.size();
+    size_t written    = 0;
+    while (_index < size) {
+        // the filter of the phase runs over the _taps samples ending at _index
+        output[written++] = qtw::dot_product(_buffer.data() + _index + 1 - _taps, _filters.data() + _phase * _taps, _taps);
+        _phase += _down;
+        _index += _phase / _up;
+        _phase %= _up;
+    }
+
+    // the last _taps - 1 samples are the history of the next block
+    const size_t keep     = _taps - 1;
+    const size_t consumed = size - keep;
+    std::copy(_buffer.begin() + consumed, _buffer.end(), _buffer.begin());
+    _buffer.resize(keep);
+    _index -= consumed;
+    return written;
+}
+
+void AudioConverter::downmixInto(const char *frames, size_t count, float *out) const
+{
+    const int channels = _input.channelCount();
+    switch (_input.sampleFormat()) {
+    case QAudioFormat::UInt8:
+        qtw::downmix<quint8>(frames, count, channels, -128.0f, 1.0f / 128, out);
+        break;
+    case QAudioFormat::Int16:
+        qtw::downmix<qint16>(frames, count, channels, 0.0f, 1.0f / 32768, out);
+        break;
+    case QAudioFormat::Int32:
+        qtw::downmix<qint32>(frames, count, channels, 0.0f, 1.0f / 2147483648.0f, out);
+        break;
+    case QAudioFormat::Float:
+        qtw::downmix<float>(frames, count, channels, 0.0f, 1.0f, out);
+        break;
+    default:
+        Q_ASSERT_X(false, "AudioConverter", "unknown sample format");
+        std::fill_n(out, count, 0.0f);
+        break;
+    }
+}
+
+void AudioConverter::reset()
+{
+    // zero history - the first output sample is aligned with the first input sample
+    _buffer.assign(_taps > 0 ? _taps - 1 : 0, 0.0f);
+    _index       = _buffer.size();
+    _phase       = 0;
+    _partialSize = 0;
+}
+
+const QAudioFormat &AudioConverter::inputFormat() const
+{
+    return _input;
+}
+
+size_t AudioConverter::taps() const
+{
+    return _taps;
+}
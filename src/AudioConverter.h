@@ -0,0 +1,55 @@
+#ifndef AUDIOCONVERTER_H
+#define AUDIOCONVERTER_H
+
+#include <QAudioFormat>
+#include <array>
+#include <span>
+#include <vector>
+
+/// Converts interleaved audio in any QAudioFormat into mono float samples at the whisper sample rate.
+/// Blocks are downmixed to float and resampled by a polyphase windowed-sinc filter. The conversion is
+/// incremental - filter history and partial frames are carried over between calls, and the working
+/// buffers only grow, so steady state conversion does not allocate.
+class AudioConverter
+{
+public:
+    explicit AudioConverter(const QAudioFormat& input, int outputRate = 16000);
+
+    /// Upper bound of the samples convert() produces from \a inputBytes of input
+    size_t maxOutput(size_t inputBytes) const;
+    /// Downmix, convert and resample \a input into \a output - which must hold maxOutput(input.size()) samples.
+    /// Returns the number of samples written.
+    size_t convert(std::span<const char> input, std::span<float> output);
+    /// Forget the carried over state
+    void reset();
+    const QAudioFormat& inputFormat() const;
+    /// Taps of each polyphase filter - 0 if the rates match and samples are passed through
+    size_t taps() const;
+
+private:
+    /// Mono float samples of \a count interleaved frames
+    void downmixInto(const char *frames, size_t count, float *out) const;
+    /// Filter the working buffer into \a output, keeping the history for the next block
+    size_t resample(float *output);
+    void designFilter();
+
+    QAudioFormat _input;
+    int _outputRate;
+    /// Resampling ratio _up / _down in lowest terms
+    int _up   = 1;
+    int _down = 1;
+    /// Taps per phase, a multiple of qtw::RESAMPLE_LANES
+    size_t _taps = 0;
+    /// _up filters of _taps coefficients, reversed so they run over the input in order
+    std::vector<float> _filters;
+    /// Filter history (_taps - 1 samples) followed by the samples of the current block
+    std::vector<float> _buffer;
+    /// Input index (in _buffer) and phase of the next output sample
+    size_t _index = 0;
+    int _phase = 0;
+    /// Bytes of a frame split between two calls
+    std::array<char, 64> _partial;
+    size_t _partialSize = 0;
+};
+
+#endif // AUDIOCONVERTER_H
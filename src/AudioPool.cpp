@@ -0,0 +1,196 @@
+#include "AudioPool.h"
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+struct AudioPool::State {
+    std::mutex mutex;
+    std::vector<AudioBlock *> free;
+    size_t capacity = 0;
+    ~State();
+};
+
+struct AudioBlock {
+    std::atomic<int> refs{ 0 };
+    std::vector<float> samples;
+    /// Pool the block returns to - only set while the block is handed out
+    std::shared_ptr<AudioPool::State> pool;
+
+    void ref()
+    {
+        refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void unref()
+    {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        // Last handle is gone - hand the block back. The pool reference is moved out first,
+        // so the pool may safely go away together with its free blocks once the lock is released.
+        auto state = std::move(pool);
+        samples.clear();
+        {
+            std::lock_guard lock{ state->mutex };
+            state->free.push_back(this);
+        }
+    }
+};
+
+AudioPool::State::~State()
+{
+    for (auto block : free) {
+        delete block;
+    }
+}
+
+AudioBuffer::AudioBuffer(AudioBlock *block) : _block{ block }
+{
+    _block->ref();
+}
+
+AudioBuffer::AudioBuffer(const AudioBuffer &other) : _block{ other._block }
+{
+    if (_block) {
+        _block->ref();
+    }
+}
+
+AudioBuffer::AudioBuffer(AudioBuffer &&other) noexcept : _block{ std::exchange(other._block, nullptr) }
+{ }
+
+AudioBuffer &AudioBuffer::operator=(const AudioBuffer &other)
+{
+    if (other._block) {
+        other._block->ref();
+    }
+    release();
+    _block = other._block;
+    return *this;
+}
+
+AudioBuffer &AudioBuffer::operator=(AudioBuffer &&other) noexcept
+{
+    if (this != &other) {
+        release();
+        _block = std::exchange(other._block, nullptr);
+    }
+    return *this;
+}
+
+AudioBuffer::~AudioBuffer()
+{
+    release();
+}
+
+bool AudioBuffer::isNull() const
+{
+    return _block == nullptr;
+}
+
+const float *AudioBuffer::data() const
+{
+    return _block ? _block->samples.data() : nullptr;
+}
+
+float *AudioBuffer::data()
+{
+    return _block ? _block->samples.data() : nullptr;
+}
+
+size_t AudioBuffer::size() const
+{
+    return _block ? _block->samples.size() : 0;
+}
+
+bool AudioBuffer::empty() const
+{
+    return size() == 0;
+}
+
+std::span<const float> AudioBuffer::samples() const
+{
+    return { data(), size() };
+}
+
+void AudioBuffer::append(std::span<const float> samples)
+{
+    Q_ASSERT(_block);
+    _block->samples.insert(_block->samples.end(), samples.begin(), samples.end());
+}
+
+std::span<float> AudioBuffer::grow(size_t n)
+{
+    Q_ASSERT(_block);
+    const auto offset = _block->samples.size();
+    _block->samples.resize(offset + n);
+    return { _block->samples.data() + offset, n };
+}
+
+void AudioBuffer::resize(size_t n)
+{
+    Q_ASSERT(_block);
+    _block->samples.resize(n);
+}
+
+void AudioBuffer::clear()
+{
+    if (_block) {
+        _block->samples.clear();
+    }
+}
+
+void AudioBuffer::release()
+{
+    if (_block) {
+        std::exchange(_block, nullptr)->unref();
+    }
+}
+
+AudioPool::AudioPool(size_t blockCapacity, size_t preallocated) : _state{ std::make_shared<State>() }
+{
+    _state->capacity = blockCapacity;
+    _state->free.reserve(preallocated);
+    for (size_t i = 0; i < preallocated; i++) {
+        auto block = new AudioBlock;
+        block->samples.reserve(blockCapacity);
+        _state->free.push_back(block);
+    }
+}
+
+AudioBuffer AudioPool::acquire()
+{
+    AudioBlock *block = nullptr;
+    {
+        std::lock_guard lock{ _state->mutex };
+        if (!_state->free.empty()) {
+            block = _state->free.back();
+            _state->free.pop_back();
+        }
+    }
+    if (!block) {
+        block = new AudioBlock;
+        block->samples.reserve(_state->capacity);
+    }
+    block->pool = _state;
+    return AudioBuffer{ block };
+}
+
+size_t AudioPool::blockCapacity() const
+{
+    return _state->capacity;
+}
+
+size_t AudioPool::freeBlocks() const
+{
+    std::lock_guard lock{ _state->mutex };
+    return _state->free.size();
+}
+
+AudioPool &AudioPool::shared()
+{
+    static AudioPool pool;
+    return pool;
+}
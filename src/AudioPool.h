@@ -0,0 +1,71 @@
+#ifndef AUDIOPOOL_H
+#define AUDIOPOOL_H
+
+#include <QMetaType>
+#include <memory>
+#include <span>
+
+struct AudioBlock;
+
+/// Reference counted handle to a block of samples borrowed from an AudioPool.
+/// Copies share the same samples - the block goes back to its pool when the last handle is released.
+class AudioBuffer
+{
+public:
+    AudioBuffer() = default;
+    AudioBuffer(const AudioBuffer& other);
+    AudioBuffer(AudioBuffer&& other) noexcept;
+    AudioBuffer& operator=(const AudioBuffer& other);
+    AudioBuffer& operator=(AudioBuffer&& other) noexcept;
+    ~AudioBuffer();
+
+    /// Whether the handle refers to a block at all
+    bool isNull() const;
+    const float *data() const;
+    float *data();
+    size_t size() const;
+    bool empty() const;
+    std::span<const float> samples() const;
+
+    /// Append samples to the block - it only allocates if the pooled capacity is exceeded
+    void append(std::span<const float> samples);
+    /// Extend the block by n samples and return them for writing (e.g. reading a device straight into it)
+    std::span<float> grow(size_t n);
+    /// Change the sample count - shrinking keeps the capacity
+    void resize(size_t n);
+    void clear();
+
+private:
+    friend class AudioPool;
+    explicit AudioBuffer(AudioBlock *block);
+    void release();
+
+    AudioBlock *_block = nullptr;
+};
+Q_DECLARE_METATYPE(AudioBuffer)
+
+/// Pool of preallocated sample blocks. Released blocks keep their capacity and are handed out again,
+/// so steady state capture does not touch the heap. Safe to use from multiple threads.
+class AudioPool
+{
+public:
+    /// Default block capacity - 30 s of 16 kHz audio, the length of a whisper window
+    static constexpr size_t DEFAULT_BLOCK_CAPACITY = 30 * 16000;
+
+    explicit AudioPool(size_t blockCapacity = DEFAULT_BLOCK_CAPACITY, size_t preallocated = 0);
+    /// Take an empty block out of the pool, allocating a new one only if none is free
+    AudioBuffer acquire();
+    /// Capacity (in samples) of newly allocated blocks
+    size_t blockCapacity() const;
+    /// Number of blocks waiting to be reused
+    size_t freeBlocks() const;
+    /// Process wide pool shared by all the sessions
+    static AudioPool& shared();
+
+private:
+    friend struct AudioBlock;
+    struct State;
+    std::shared_ptr<State> _state;
+};
+
+#endif // AUDIOPOOL_H
@@ -0,0 +1,19 @@
+#ifndef CANCELTOKEN_H
+#define CANCELTOKEN_H
+
+#include <QtGlobal>
+#include <atomic>
+
+/// Cooperative cancellation of work started at a given generation. Cancelling moves the generation on,
+/// the work notices it at its next checkpoint. A default constructed token is never cancelled.
+struct CancelToken {
+    const std::atomic<quint64> *generation = nullptr;
+    quint64 taken = 0;
+
+    bool cancelled() const
+    {
+        return generation && generation->load(std::memory_order_relaxed) != taken;
+    }
+};
+
+#endif // CANCELTOKEN_H
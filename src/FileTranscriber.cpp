@@ -0,0 +1,189 @@
+#include "FileTranscriber.h"
+#include "Trace.h"
+#include <QDebug>
+
+constexpr int SAMPLE_RATE = 16000;
+/// Length of one decoded chunk
+constexpr int CHUNK_MS = 30;
+/// Chunks decoded per event loop iteration
+constexpr int CHUNKS_PER_PUMP = 100;
+/// Segments allowed to wait for the backend before reading is throttled
+constexpr int MAX_OUTSTANDING = 2;
+/// Bytes a sequential device has to buffer before the header is parsed
+constexpr qint64 HEADER_BYTES = 4096;
+
+FileTranscriber::FileTranscriber(QObject *parent) : QObject{parent}
+{
+    _pump.setInterval(0);
+    _pump.callOnTimeout(this, &FileTranscriber::pump);
+}
+
+FileTranscriber::~FileTranscriber()
+{
+    release();
+}
+
+bool FileTranscriber::start(QIODevice *device, bool owned)
+{
+    if (isRunning()) {
+        return false;
+    }
+    if (!device || !device->isReadable()) {
+        emit error("Input device is not open for reading");
+        if (device && owned) {
+            device->deleteLater();
+        }
+        return false;
+    }
+    _device         = device;
+    _owned          = owned;
+    _deviceFinished = false;
+    _inputDone      = false;
+    _outstanding    = 0;
+
+    if (device->isSequential()) {
+        // data arrives over time - resume decoding whenever there is more
+        connect(device, &QIODevice::readyRead, this, [ = ](){
+            _pump.start();
+        });
+        connect(device, &QIODevice::readChannelFinished, this, [ = ](){
+            _deviceFinished = true;
+            _pump.start();
+        });
+    }
+    _pump.start();
+    return true;
+}
+
+void FileTranscriber::cancel()
+{
+    if (!isRunning()) {
+        return;
+    }
+    _pump.stop();
+    release();
+    _inputDone   = true;
+    _outstanding = 0;
+    emit finished();
+}
+
+bool FileTranscriber::isRunning() const
+{
+    return !_inputDone || _outstanding > 0;
+}
+
+void FileTranscriber::segmentDone()
+{
+    if (_outstanding == 0) {
+        return;
+    }
+    if (--_outstanding == 0 && _inputDone) {
+        emit finished();
+        return;
+    }
+    if (!_inputDone) {
+        _pump.start();
+    }
+}
+
+void FileTranscriber::pump()
+{
+    if (!_decoder && !openDecoder()) {
+        return;
+    }
+
+    for (int i = 0; i < CHUNKS_PER_PUMP; i++) {
+        if (_outstanding >= MAX_OUTSTANDING) {
+            // throttled - segmentDone() resumes reading
+            _pump.stop();
+            break;
+        }
+        const auto n = _decoder->read(_chunk.data(), _chunk.size());
+        if (n < 0 || (n == 0 && (!_device->isSequential() || _deviceFinished))) {
+            endOfInput();
+            return;
+        }
+        if (n == 0) {
+            // wait for readyRead
+            _pump.stop();
+            break;
+        }
+
+        // convert straight into the voice buffer of the detector
+        auto dst = _vad->prepareSamples(_converter->maxOutput(n));
+        const auto samples = _converter->convert({ _chunk.constData(), static_cast<size_t>(n) }, dst);
+        _vad->commitSamples(samples);
+    }
+
+    if (_decoder->dataSize() > 0) {
+        emit progress(static_cast<qreal>(_decoder->bytesRead()) / _decoder->dataSize());
+    }
+} // FileTranscriber::pump
+
+bool FileTranscriber::openDecoder()
+{
+    if (_device->isSequential() && !_deviceFinished && _device->bytesAvailable() < HEADER_BYTES) {
+        // not enough data to parse the header yet
+        _pump.stop();
+        return false;
+    }
+
+    _decoder = std::make_unique<WavDecoder>(*_device);
+    if (!_decoder->open()) {
+        emit error(_decoder->errorString());
+        _pump.stop();
+        _inputDone = true;
+        release();
+        return false;
+    }
+    const auto format = _decoder->format();
+    _converter = std::make_unique<AudioConverter>(format, SAMPLE_RATE);
+    _chunk.resize(format.bytesForDuration(CHUNK_MS * 1000));
+
+    // recordings carry no background noise calibration phase like a live microphone - tune on the first half second
+    auto params = VoiceActivityDetector::defaultParams();
+    params.adjust_samples = 500 / VadEngine::FRAME_MS;
+    _vad = std::make_unique<VoiceActivityDetector>(params);
+    auto segment = [ = ](AudioBuffer samples){
+        if (samples.isNull()) {
+            return;
+        }
+        _outstanding++;
+        emit segmentReady(samples);
+    };
+    // long speech is handed over in pieces
+    connect(_vad.get(), &VoiceActivityDetector::speechDetected, this, segment);
+    connect(_vad.get(), &VoiceActivityDetector::speechChunkDetected, this, segment);
+    qCDebug(lcCapture) << "Transcribing" << format << "data size:" << _decoder->dataSize();
+    return true;
+}
+
+void FileTranscriber::endOfInput()
+{
+    _pump.stop();
+    // speech running up to the end of the recording
+    _vad->flush();
+    if (_decoder->dataSize() > 0) {
+        emit progress(1.0);
+    }
+    _inputDone = true;
+    release();
+    if (_outstanding == 0) {
+        emit finished();
+    }
+}
+
+void FileTranscriber::release()
+{
+    _vad.reset();
+    _converter.reset();
+    _decoder.reset();
+    _chunk = QByteArray{ };
+    if (_device) {
+        disconnect(_device, nullptr, this, nullptr);
+        if (_owned) {
+            _device->deleteLater();
+        }
+    }
+    _device = nullptr;
+}
@@ -0,0 +1,61 @@
+#ifndef FILETRANSCRIBER_H
+#define FILETRANSCRIBER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <memory>
+#include "AudioConverter.h"
+#include "AudioPool.h"
+#include "VoiceActivityDetector.h"
+#include "WavDecoder.h"
+
+/// Segments a recorded WAV/PCM stream into utterances for the whisper backend.
+/// The input is decoded in fixed-size chunks and at most a few segments are in flight at any time,
+/// so the memory footprint does not depend on the length of the recording.
+class FileTranscriber : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FileTranscriber(QObject *parent = nullptr);
+    ~FileTranscriber();
+
+    /// Start segmenting \a device, which has to be open for reading. The transcriber deletes the device when done if \a owned.
+    bool start(QIODevice *device, bool owned = false);
+    /// Stop reading and forget the segments still waiting for transcription
+    void cancel();
+    bool isRunning() const;
+    /// Report that a segment emitted by segmentReady() was transcribed - resumes reading if it was throttled
+    void segmentDone();
+
+signals:
+    void segmentReady(AudioBuffer samples);
+    /// Fraction of the input processed so far - only emitted when the input size is known
+    void progress(qreal fraction);
+    /// All segments were emitted and transcribed
+    void finished();
+    void error(const QString& message);
+
+private:
+    /// Decode a batch of chunks - called from the event loop until the input is exhausted
+    void pump();
+    bool openDecoder();
+    void endOfInput();
+    void release();
+
+    QPointer<QIODevice> _device;
+    bool _owned = false;
+    /// A sequential device signalled there is nothing more to read
+    bool _deviceFinished = false;
+    bool _inputDone = true;
+    std::unique_ptr<WavDecoder> _decoder;
+    std::unique_ptr<AudioConverter> _converter;
+    std::unique_ptr<VoiceActivityDetector> _vad;
+    /// Reusable buffer holding one encoded chunk
+    QByteArray _chunk;
+    /// Segments emitted but not yet transcribed
+    int _outstanding = 0;
+    QTimer _pump;
+};
+
+#endif // FILETRANSCRIBER_H
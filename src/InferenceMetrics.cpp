@@ -0,0 +1,86 @@
+#include "InferenceMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double NS_PER_MS = 1e6;
+
+void push_window(std::deque<double>& window, double value)
+{
+    window.push_back(value);
+    if (window.size() > InferenceMetrics::WINDOW) {
+        window.pop_front();
+    }
+}
+} // namespace
+
+InferenceMetrics::InferenceMetrics(QObject *parent) : QObject{parent}
+{
+    qRegisterMetaType<InferenceTiming>();
+}
+
+double InferenceMetrics::percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    // nearest rank - a partial sort is enough for a single rank
+    const auto rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+    const auto nth  = values.begin() + std::clamp<size_t>(rank, 1, values.size()) - 1;
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+void InferenceMetrics::record(const InferenceTiming &timing)
+{
+    if (!timing.complete()) {
+        // a real time factor of 0 would drag the percentiles down
+        return;
+    }
+    const auto processing = timing.processing_ns();
+    const double rtf = timing.audio_ns > 0 ? static_cast<double>(processing) / timing.audio_ns : 0;
+
+    setUtterances(getUtterances() + 1);
+    setAudioMs(timing.audio_ns / NS_PER_MS);
+    setQueueWaitMs(timing.queue_ns / NS_PER_MS);
+    setMelMs(timing.mel_ns / NS_PER_MS);
+    setEncodeMs(timing.encode_ns / NS_PER_MS);
+    setDecodeMs(timing.decode_ns / NS_PER_MS);
+    setRealTimeFactor(rtf);
+    setTokensPerSecond(timing.decode_ns > 0 ? timing.tokens * 1e9 / timing.decode_ns : 0);
+
+    push_window(_rtfs, rtf);
+    push_window(_latencies, (timing.queue_ns + processing) / NS_PER_MS);
+    const std::vector<double> rtfs{ _rtfs.begin(), _rtfs.end() };
+    const std::vector<double> latencies{ _latencies.begin(), _latencies.end() };
+    setRtfP50(percentile(rtfs, 50));
+    setRtfP95(percentile(rtfs, 95));
+    setRtfP99(percentile(rtfs, 99));
+    setLatencyP50Ms(percentile(latencies, 50));
+    setLatencyP95Ms(percentile(latencies, 95));
+    setLatencyP99Ms(percentile(latencies, 99));
+
+    emit updated();
+}
+
+void InferenceMetrics::reset()
+{
+    _rtfs.clear();
+    _latencies.clear();
+    setUtterances(0);
+    setAudioMs(0);
+    setQueueWaitMs(0);
+    setMelMs(0);
+    setEncodeMs(0);
+    setDecodeMs(0);
+    setRealTimeFactor(0);
+    setTokensPerSecond(0);
+    setRtfP50(0);
+    setRtfP95(0);
+    setRtfP99(0);
+    setLatencyP50Ms(0);
+    setLatencyP95Ms(0);
+    setLatencyP99Ms(0);
+    emit updated();
+}
@@ -0,0 +1,75 @@
+#ifndef INFERENCEMETRICS_H
+#define INFERENCEMETRICS_H
+
+#include <QObject>
+#include <deque>
+#include "QmlMacros.h"
+
+/// Measurements of a single decode, taken on the worker that ran it
+struct InferenceTiming {
+    /// Duration of the decoded audio
+    qint64 audio_ns  = 0;
+    /// Time the utterance waited for a free worker
+    qint64 queue_ns  = 0;
+    /// Log mel spectrogram
+    qint64 mel_ns    = 0;
+    qint64 encode_ns = 0;
+    /// Decoder passes including token sampling
+    qint64 decode_ns = 0;
+    int tokens = 0;
+
+    /// Time spent by the worker - the queue wait is not part of it
+    qint64 processing_ns() const { return mel_ns + encode_ns + decode_ns; }
+    /// Whether all the phases were timed - not the case for aborted or failed decodes
+    bool complete() const { return audio_ns > 0 && mel_ns > 0 && encode_ns > 0 && decode_ns > 0; }
+};
+Q_DECLARE_METATYPE(InferenceTiming)
+
+/// Per utterance performance of the inference, together with percentiles over the recent utterances.
+/// Lives in the thread of SpeechToText - the backend reports the timings through queued signals.
+class InferenceMetrics : public QObject
+{
+    Q_OBJECT
+    /// Decoded utterances since the last reset
+    QML_READONLY_PROPERTY(int, utterances, Utterances)
+    /// Values of the last utterance, in milliseconds
+    QML_READONLY_PROPERTY(double, audioMs, AudioMs)
+    QML_READONLY_PROPERTY(double, queueWaitMs, QueueWaitMs)
+    QML_READONLY_PROPERTY(double, melMs, MelMs)
+    QML_READONLY_PROPERTY(double, encodeMs, EncodeMs)
+    QML_READONLY_PROPERTY(double, decodeMs, DecodeMs)
+    /// Processing time divided by the audio duration of the last utterance - below 1 is faster than real time
+    QML_READONLY_PROPERTY(double, realTimeFactor, RealTimeFactor)
+    QML_READONLY_PROPERTY(double, tokensPerSecond, TokensPerSecond)
+    /// Real time factor percentiles over the last WINDOW utterances
+    QML_READONLY_PROPERTY(double, rtfP50, RtfP50)
+    QML_READONLY_PROPERTY(double, rtfP95, RtfP95)
+    QML_READONLY_PROPERTY(double, rtfP99, RtfP99)
+    /// Latency (queue wait and processing) percentiles over the last WINDOW utterances, in milliseconds
+    QML_READONLY_PROPERTY(double, latencyP50Ms, LatencyP50Ms)
+    QML_READONLY_PROPERTY(double, latencyP95Ms, LatencyP95Ms)
+    QML_READONLY_PROPERTY(double, latencyP99Ms, LatencyP99Ms)
+public:
+    /// Utterances the percentiles are computed over
+    static constexpr size_t WINDOW = 256;
+
+    explicit InferenceMetrics(QObject *parent = nullptr);
+
+    /// Nearest-rank percentile \a p (0-100) of \a values - 0 for no values
+    static double percentile(std::vector<double> values, double p);
+
+public slots:
+    /// Add the timings of an utterance - incomplete ones (see InferenceTiming::complete) are ignored
+    void record(const InferenceTiming& timing);
+    void reset();
+
+signals:
+    /// Emitted after all the properties of a recorded utterance were updated
+    void updated();
+
+private:
+    std::deque<double> _rtfs;
+    std::deque<double> _latencies;
+};
+
+#endif // INFERENCEMETRICS_H
@@ -0,0 +1,195 @@
+#include "InferencePool.h"
+#include "Trace.h"
+#include "decodetimeline.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+/// Target of the new segment callback of one decode
+struct SegmentSink {
+    InferencePool *pool;
+    quint64 sequence;
+    CancelToken cancel;
+};
+} // namespace
+
+InferencePool::InferencePool(whisper_context *ctx, int workers, QObject *parent)
+    : QObject{parent}, _ctx{ctx}
+{
+    Q_ASSERT(ctx);
+    for (int i = 0; i < std::max(workers, 1); i++) {
+        auto state = whisper_init_state(ctx);
+        if (!state) {
+            qWarning() << "Failed to allocate whisper state for worker" << i;
+            break;
+        }
+        _states.push_back(state);
+    }
+    _freeStates = _states;
+    // a worker never waits for a state - there are exactly as many threads as states
+    _threads.setMaxThreadCount(std::max<int>(_states.size(), 1));
+    _threads.setObjectName("whisper-inference");
+    qCDebug(lcInference) << "Inference pool with" << _states.size() << "workers";
+}
+
+InferencePool::~InferencePool()
+{
+    _threads.clear();
+    _threads.waitForDone();
+    // deliver the completions of the decodes that finished meanwhile - they would be dropped with the object
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    // the jobs dropped from the queue never complete - callers count on a result per submit
+    while (_nextReport < _nextSequence) {
+        const auto finished = _finished.find(_nextReport);
+        emit resultReady(_nextReport++, finished != _finished.end() ? finished->second : QString{ });
+    }
+    for (auto state : _states) {
+        whisper_free_state(state);
+    }
+}
+
+int InferencePool::workers() const
+{
+    return static_cast<int>(_states.size());
+}
+
+quint64 InferencePool::submit(AudioBuffer samples, const whisper_full_params &params, CancelToken cancel)
+{
+    const auto sequence = _nextSequence++;
+    if (_states.empty()) {
+        // reported in order like any other failed decode
+        complete(sequence, QString{ });
+        return sequence;
+    }
+
+    const auto queued = qtw::trace::now();
+    _threads.start([ = ](){
+        if (QThread::currentThread()->objectName().isEmpty()) {
+            QThread::currentThread()->setObjectName("whisper-inference");
+        }
+        qtw::DecodeTimeline timeline;
+        timeline.start = qtw::trace::now();
+        QTW_TRACE_COMPLETE(lcQueue, "queue wait", queued, timeline.start);
+        if (cancel.cancelled()) {
+            // cancelled while queued - still reported to keep the order
+            QMetaObject::invokeMethod(this, [ = ](){
+                complete(sequence, QString{ });
+            }, Qt::QueuedConnection);
+            return;
+        }
+
+        auto state = acquireState();
+        // the callbacks timestamp the phases for the metrics and the trace
+        auto worker_params = params;
+        timeline.cancel = cancel;
+        timeline.install(worker_params);
+        // segments are handed out while the rest of the utterance is still being decoded
+        SegmentSink sink{ this, sequence, cancel };
+        worker_params.new_segment_callback = [](whisper_context *, whisper_state *state, int n_new, void *user_data) {
+            const auto sink  = static_cast<SegmentSink *>(user_data);
+            if (sink->cancel.cancelled()) {
+                return;
+            }
+            const int n_seg = whisper_full_n_segments_from_state(state);
+            for (int i = std::max(n_seg - n_new, 0); i < n_seg; i++) {
+                const QString text = whisper_full_get_segment_text_from_state(state, i);
+                // timestamps are in units of 10 ms
+                const qint64 start_ms = whisper_full_get_segment_t0_from_state(state, i) * 10;
+                const qint64 end_ms   = whisper_full_get_segment_t1_from_state(state, i) * 10;
+                QMetaObject::invokeMethod(sink->pool, [ = , pool = sink->pool, sequence = sink->sequence](){
+                    emit pool->segmentReady(sequence, text, start_ms, end_ms);
+                }, Qt::QueuedConnection);
+            }
+        };
+        worker_params.new_segment_callback_user_data = &sink;
+        if (whisper_full_with_state(_ctx, state, worker_params, samples.data(), static_cast<int>(samples.size())) != 0) {
+            qWarning() << "Failed to process utterance" << sequence;
+        }
+        timeline.end = qtw::trace::now();
+        if (timeline.complete()) {
+            QTW_TRACE_COMPLETE(lcInference, "mel", timeline.start, timeline.encode_begin);
+            QTW_TRACE_COMPLETE(lcInference, "encode", timeline.encode_begin, timeline.decode_begin);
+            QTW_TRACE_COMPLETE(lcInference, "decode", timeline.decode_begin, timeline.end);
+        }
+
+        InferenceTiming timing;
+        timing.audio_ns = static_cast<qint64>(samples.size()) * 1000000000 / WHISPER_SAMPLE_RATE;
+        timing.queue_ns = timeline.start - queued;
+        if (timeline.complete()) {
+            timing.mel_ns    = timeline.mel_ns();
+            timing.encode_ns = timeline.encode_ns();
+            timing.decode_ns = timeline.decode_ns();
+        }
+
+        // the text of an interrupted decode is incomplete - it is dropped
+        const bool cancelled = cancel.cancelled();
+        QString text;
+        const int n_seg = cancelled ? 0 : whisper_full_n_segments_from_state(state);
+        for (int i = 0; i < n_seg; i++) {
+            text.append(whisper_full_get_segment_text_from_state(state, i));
+            timing.tokens += whisper_full_n_tokens_from_state(state, i);
+        }
+        releaseState(state);
+
+        QMetaObject::invokeMethod(this, [ = ](){
+            if (!cancelled && timing.complete()) {
+                emit timingReady(timing);
+            }
+            complete(sequence, text);
+        }, Qt::QueuedConnection);
+    });
+    return sequence;
+}
+
+void InferencePool::warmUp(std::span<const float> samples, const whisper_full_params &params, CancelToken cancel)
+{
+    QMutexLocker lock{ &_statesMutex };
+    for (auto state : _freeStates) {
+        _threads.start([ = ](){
+            qtw::DecodeTimeline timeline;
+            timeline.cancel = cancel;
+            auto worker_params = params;
+            timeline.install(worker_params);
+            whisper_full_with_state(_ctx, state, worker_params, samples.data(), static_cast<int>(samples.size()));
+        });
+    }
+}
+
+void InferencePool::waitForWarmUp()
+{
+    _threads.waitForDone();
+}
+
+int InferencePool::pending() const
+{
+    return static_cast<int>(_nextSequence - _nextReport);
+}
+
+void InferencePool::complete(quint64 sequence, QString text)
+{
+    _finished.emplace(sequence, std::move(text));
+    // report everything that is no longer waiting for an earlier utterance
+    for (auto it = _finished.begin(); it != _finished.end() && it->first == _nextReport; it = _finished.erase(it)) {
+        _nextReport++;
+        emit resultReady(it->first, it->second);
+    }
+}
+
+whisper_state *InferencePool::acquireState()
+{
+    QMutexLocker lock{ &_statesMutex };
+    Q_ASSERT(!_freeStates.empty());
+    auto state = _freeStates.back();
+    _freeStates.pop_back();
+    return state;
+}
+
+void InferencePool::releaseState(whisper_state *state)
+{
+    QMutexLocker lock{ &_statesMutex };
+    _freeStates.push_back(state);
+}
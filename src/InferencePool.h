@@ -0,0 +1,67 @@
+#ifndef INFERENCEPOOL_H
+#define INFERENCEPOOL_H
+
+#include <QObject>
+#include <QMutex>
+#include <QThreadPool>
+#include <map>
+#include <span>
+#include <vector>
+#include "whisper.h"
+#include "AudioPool.h"
+#include "InferenceMetrics.h"
+#include "CancelToken.h"
+
+/// Runs inference for queued utterances on several worker threads sharing one set of model weights.
+/// Each worker decodes with its own whisper_state, so the context itself is only read.
+/// Results are reported in submission order.
+class InferencePool : public QObject
+{
+    Q_OBJECT
+public:
+    /// \a ctx has to outlive the pool - one state is created per worker
+    InferencePool(whisper_context *ctx, int workers, QObject *parent = nullptr);
+    /// Waits for the running decodes - queued ones are dropped. Every utterance not reported yet
+    /// is still reported, with an empty result if it was not decoded.
+    ~InferencePool();
+
+    /// Number of workers with a state - lower than requested if a state could not be allocated
+    int workers() const;
+    /// Queue \a samples for inference, returns the sequence number of the utterance.
+    /// Once \a cancel is cancelled the decode stops at its next checkpoint and reports an empty result.
+    quint64 submit(AudioBuffer samples, const whisper_full_params& params, CancelToken cancel = CancelToken{ });
+    /// Utterances submitted but not reported yet
+    int pending() const;
+    /// Start decoding \a samples on every idle state, without reporting results. \a samples has to stay valid
+    /// until waitForWarmUp() returns.
+    void warmUp(std::span<const float> samples, const whisper_full_params& params, CancelToken cancel = CancelToken{ });
+    void waitForWarmUp();
+
+signals:
+    /// Result of the utterance \a sequence - emitted in submission order
+    void resultReady(quint64 sequence, QString text);
+    /// Segment of the utterance \a sequence, emitted as soon as it is decoded - before resultReady of the utterance.
+    /// Times are relative to the start of the utterance. With several workers segments of different utterances interleave.
+    void segmentReady(quint64 sequence, QString text, qint64 startMs, qint64 endMs);
+    /// Timings of a finished decode - emitted as soon as it is done, not in submission order
+    void timingReady(InferenceTiming timing);
+
+private:
+    /// Called in the thread of the pool once a worker is done with \a sequence
+    void complete(quint64 sequence, QString text);
+    whisper_state *acquireState();
+    void releaseState(whisper_state *state);
+
+    whisper_context *_ctx;
+    QThreadPool _threads;
+    QMutex _statesMutex;
+    /// States not used by any worker right now
+    std::vector<whisper_state *> _freeStates;
+    std::vector<whisper_state *> _states;
+    /// Finished results waiting for an earlier utterance
+    std::map<quint64, QString> _finished;
+    quint64 _nextSequence = 0;
+    quint64 _nextReport = 0;
+};
+
+#endif // INFERENCEPOOL_H
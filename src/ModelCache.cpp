@@ -0,0 +1,152 @@
+#include "ModelCache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+/// Bytes hashed at each end of the source model. Together with the size and modification time this
+/// identifies the model without reading all of it - the head holds hparams, mel filters and vocab.
+constexpr qint64 FINGERPRINT_BYTES = 1 << 20;
+
+ModelCache::ModelCache(const QString &directory, qint64 sizeLimit)
+    : _directory{directory}, _sizeLimit{sizeLimit}
+{ }
+
+QString ModelCache::directory() const
+{
+    return _directory;
+}
+
+qint64 ModelCache::sizeLimit() const
+{
+    return _sizeLimit;
+}
+
+bool ModelCache::isEnabled() const
+{
+    return !_directory.isEmpty() && _sizeLimit > 0;
+}
+
+QString ModelCache::lookup(const QString &sourcePath, ggml_ftype ftype) const
+{
+    if (!isEnabled()) {
+        return QString{ };
+    }
+    const auto path = entryPath(sourcePath, ftype);
+    if (path.isEmpty() || !QFileInfo::exists(path)) {
+        return QString{ };
+    }
+
+    // Bump the modification time - it is the recency used for eviction
+    QFile entry{ path };
+    if (entry.open(QIODeviceBase::ReadWrite)) {
+        entry.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+    return path;
+}
+
+QString ModelCache::store(const QString &sourcePath, ggml_ftype ftype, const QByteArray &model) const
+{
+    if (model.size() > _sizeLimit) {
+        return QString{ };
+    }
+    auto file = storeWriter(sourcePath, ftype);
+    if (!file) {
+        return QString{ };
+    }
+    if (file->write(model) != model.size()) {
+        qWarning() << "Failed to store quantized model in cache:" << file->fileName() << file->errorString();
+        file->cancelWriting();
+        return QString{ };
+    }
+    return commit(*file);
+}
+
+std::unique_ptr<QSaveFile> ModelCache::storeWriter(const QString &sourcePath, ggml_ftype ftype) const
+{
+    if (!isEnabled()) {
+        return nullptr;
+    }
+    const auto path = entryPath(sourcePath, ftype);
+    if (path.isEmpty() || !QDir{}.mkpath(_directory)) {
+        return nullptr;
+    }
+
+    // written to a temporary file and renamed on commit - readers never see a partial model
+    auto file = std::make_unique<QSaveFile>(path);
+    if (!file->open(QIODeviceBase::WriteOnly)) {
+        qWarning() << "Failed to open cache entry:" << path << file->errorString();
+        return nullptr;
+    }
+    return file;
+}
+
+QString ModelCache::commit(QSaveFile &file) const
+{
+    const auto path = file.fileName();
+    if (file.size() > _sizeLimit) {
+        // larger than the whole cache - never stored, nothing is evicted for it
+        file.cancelWriting();
+        file.commit();
+        return QString{ };
+    }
+    if (!file.commit()) {
+        qWarning() << "Failed to store quantized model in cache:" << path << file.errorString();
+        return QString{ };
+    }
+    // the size limit is enforced once the real size of the entry is known
+    evict(0, path);
+    return path;
+}
+
+QString ModelCache::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/qt-whisper";
+}
+
+QString ModelCache::entryPath(const QString &sourcePath, ggml_ftype ftype) const
+{
+    QFileInfo info{ sourcePath };
+    QFile source{ sourcePath };
+    if (!source.open(QIODeviceBase::ReadOnly)) {
+        return QString{ };
+    }
+
+    QCryptographicHash hash{ QCryptographicHash::Sha256 };
+    const qint64 identity[] = {
+        info.size(), info.lastModified().toMSecsSinceEpoch(), ftype, GGML_QNT_VERSION
+    };
+    hash.addData(QByteArrayView{ reinterpret_cast<const char *>(identity), sizeof(identity) });
+    hash.addData(source.read(FINGERPRINT_BYTES));
+    if (source.size() > 2 * FINGERPRINT_BYTES) {
+        source.seek(source.size() - FINGERPRINT_BYTES);
+    }
+    hash.addData(source.read(FINGERPRINT_BYTES));
+
+    return QStringLiteral("%1/%2-%3.bin").arg(_directory, info.completeBaseName(),
+                                                       QString::fromLatin1(hash.result().toHex().left(32)));
+}
+
+void ModelCache::evict(qint64 incoming, const QString &keep) const
+{
+    // newest first - evict from the back
+    auto entries = QDir{ _directory }.entryInfoList({ "*.bin" }, QDir::Files, QDir::Time);
+    qint64 total = incoming;
+    for (const auto& entry : entries) {
+        total += entry.size();
+    }
+    while (total > _sizeLimit && !entries.isEmpty()) {
+        const auto entry = entries.takeLast();
+        if (entry.absoluteFilePath() == QFileInfo{ keep }.absoluteFilePath()) {
+            continue;
+        }
+        if (QFile::remove(entry.absoluteFilePath())) {
+            total -= entry.size();
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef MODELCACHE_H
+#define MODELCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <memory>
+#include "ggml.h"
+
+class QSaveFile;
+
+/// On-disk cache of quantized models.
+/// Entries are keyed by the identity of the source model (size, modification time and a content fingerprint)
+/// and the target float type, so a changed source model never hits a stale entry.
+class ModelCache
+{
+public:
+    /// Default size limit of the cache directory - 2 GiB
+    static constexpr qint64 DEFAULT_SIZE_LIMIT = qint64{ 2 } << 30;
+
+    /// Empty directory disables the cache
+    explicit ModelCache(const QString& directory = QString{ }, qint64 sizeLimit = DEFAULT_SIZE_LIMIT);
+
+    QString directory() const;
+    qint64 sizeLimit() const;
+    bool isEnabled() const;
+
+    /// Path of the cached model quantized from \a sourcePath to \a ftype - empty on a cache miss
+    QString lookup(const QString& sourcePath, ggml_ftype ftype) const;
+    /// Atomically store the quantized \a model, evicting least recently used entries to stay within the size limit.
+    /// Returns the path of the new entry or an empty string if it could not be stored.
+    QString store(const QString& sourcePath, ggml_ftype ftype, const QByteArray& model) const;
+    /// Open a new entry for writing while the model is being produced - nullptr if the cache is disabled.
+    /// The size of the entry is not known up front, it is finished with commit().
+    std::unique_ptr<QSaveFile> storeWriter(const QString& sourcePath, ggml_ftype ftype) const;
+    /// Make an entry opened by storeWriter() visible and evict least recently used entries to stay within the
+    /// size limit. An entry larger than the limit is dropped. Returns its path or an empty string if not stored.
+    QString commit(QSaveFile& file) const;
+
+    /// Per-user cache location used when no directory is configured explicitly
+    static QString defaultDirectory();
+
+private:
+    QString entryPath(const QString& sourcePath, ggml_ftype ftype) const;
+    void evict(qint64 incoming, const QString& keep) const;
+
+    QString _directory;
+    qint64 _sizeLimit;
+};
+
+#endif // MODELCACHE_H
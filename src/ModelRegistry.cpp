@@ -0,0 +1,206 @@
+#include "ModelRegistry.h"
+#include "Trace.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+
+ModelRegistry::ModelRegistry(qint64 memoryBudget, Deleter deleter, QObject *parent)
+    : QObject{parent}, _deleter{std::move(deleter)}, _memoryBudget{memoryBudget}
+{ }
+
+ModelRegistry::~ModelRegistry()
+{
+    clear();
+}
+
+ModelRegistry &ModelRegistry::instance()
+{
+    static ModelRegistry registry;
+    // the first user may be a worker thread - the notifications belong to the thread of the QML engine
+    static const bool in_main_thread = [](){
+        if (auto app = QCoreApplication::instance()) {
+            registry.moveToThread(app->thread());
+        }
+        return true;
+    }();
+    Q_UNUSED(in_main_thread);
+    return registry;
+}
+
+ModelRegistry::Model ModelRegistry::acquire(const QString &path, ggml_ftype ftype, const Loader &load)
+{
+    const auto k = key(path, ftype);
+    {
+        QMutexLocker lock{ &_mutex };
+        auto it = _entries.find(k);
+        while (it != _entries.end() && it->loading) {
+            _loaded.wait(&_mutex);
+            it = _entries.find(k);
+        }
+        if (it != _entries.end()) {
+            _hits++;
+            auto model = share(k, *it);
+            lock.unlock();
+            notifyStats();
+            return model;
+        }
+        // placeholder - other requests for the model wait for this one
+        _misses++;
+        _entries[k].loading = true;
+    }
+
+    qint64 size = 0;
+    auto ctx = load(size);
+
+    QMutexLocker lock{ &_mutex };
+    std::vector<whisper_context *> evicted;
+    Model model;
+    if (ctx) {
+        auto& entry = _entries[k];
+        entry.ctx      = ctx;
+        entry.size     = size;
+        entry.loading  = false;
+        _residentBytes += size;
+        model = share(k, entry);
+        evicted = evict();
+    } else {
+        _entries.remove(k);
+    }
+    _loaded.wakeAll();
+    lock.unlock();
+
+    freeContexts(evicted);
+    notifyStats();
+    return model;
+} // ModelRegistry::acquire
+
+void ModelRegistry::clear()
+{
+    QMutexLocker lock{ &_mutex };
+    std::vector<whisper_context *> idle;
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        if (it->refs == 0 && !it->loading) {
+            idle.push_back(it->ctx);
+            _residentBytes -= it->size;
+            it = _entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    lock.unlock();
+
+    freeContexts(idle);
+    notifyStats();
+}
+
+qint64 ModelRegistry::residentBytes() const
+{
+    QMutexLocker lock{ &_mutex };
+    return _residentBytes;
+}
+
+qint64 ModelRegistry::memoryBudget() const
+{
+    QMutexLocker lock{ &_mutex };
+    return _memoryBudget;
+}
+
+void ModelRegistry::setMemoryBudget(qint64 bytes)
+{
+    QMutexLocker lock{ &_mutex };
+    _memoryBudget = bytes;
+    const auto evicted = evict();
+    lock.unlock();
+
+    freeContexts(evicted);
+    notifyStats();
+}
+
+int ModelRegistry::residentModels() const
+{
+    QMutexLocker lock{ &_mutex };
+    int n = 0;
+    for (const auto& entry : _entries) {
+        n += entry.loading ? 0 : 1;
+    }
+    return n;
+}
+
+qint64 ModelRegistry::hits() const
+{
+    QMutexLocker lock{ &_mutex };
+    return _hits;
+}
+
+qint64 ModelRegistry::misses() const
+{
+    QMutexLocker lock{ &_mutex };
+    return _misses;
+}
+
+QString ModelRegistry::key(const QString &path, ggml_ftype ftype)
+{
+    // a model replaced on disk is a different model
+    QFileInfo info{ path };
+    return QStringLiteral("%1|%2|%3|%4").arg(info.absoluteFilePath()).arg(info.size())
+           .arg(info.lastModified().toMSecsSinceEpoch()).arg(ftype);
+}
+
+ModelRegistry::Model ModelRegistry::share(const QString &key, Entry &entry)
+{
+    entry.refs++;
+    return Model{ entry.ctx, [this, key](whisper_context *){
+        release(key);
+    } };
+}
+
+void ModelRegistry::release(const QString &key)
+{
+    QMutexLocker lock{ &_mutex };
+    auto it = _entries.find(key);
+    Q_ASSERT(it != _entries.end() && it->refs > 0);
+    it->refs--;
+    it->lastUsed = ++_useCounter;
+    const auto evicted = evict();
+    lock.unlock();
+
+    freeContexts(evicted);
+    notifyStats();
+}
+
+std::vector<whisper_context *> ModelRegistry::evict()
+{
+    std::vector<whisper_context *> evicted;
+    while (_residentBytes > _memoryBudget) {
+        auto oldest = _entries.end();
+        for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+            if (it->refs == 0 && !it->loading && (oldest == _entries.end() || it->lastUsed < oldest->lastUsed)) {
+                oldest = it;
+            }
+        }
+        if (oldest == _entries.end()) {
+            // everything left is in use
+            break;
+        }
+        qCDebug(lcLoad) << "Evicting model" << oldest.key() << "-" << (oldest->size >> 20) << "MiB";
+        evicted.push_back(oldest->ctx);
+        _residentBytes -= oldest->size;
+        _entries.erase(oldest);
+    }
+    return evicted;
+}
+
+void ModelRegistry::notifyStats()
+{
+    // acquire and release run in the backend and preload threads - the properties are bound in QML
+    QMetaObject::invokeMethod(this, &ModelRegistry::statsChanged, Qt::QueuedConnection);
+}
+
+void ModelRegistry::freeContexts(const std::vector<whisper_context *> &contexts)
+{
+    for (auto ctx : contexts) {
+        _deleter(ctx);
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef MODELREGISTRY_H
+#define MODELREGISTRY_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <functional>
+#include <memory>
+#include "whisper.h"
+
+/// Process wide registry of loaded models, keyed by the source file and the requested float type.
+/// Backends using the same model share one context - each of them decodes with its own whisper_state.
+/// Released models stay resident until the memory budget is exceeded, least recently used ones are freed first.
+/// All methods are thread safe.
+class ModelRegistry : public QObject
+{
+    Q_OBJECT
+    /// Size of all the resident models in bytes
+    Q_PROPERTY(qint64 residentBytes READ residentBytes NOTIFY statsChanged)
+    /// Resident size above which idle models are freed
+    Q_PROPERTY(qint64 memoryBudget READ memoryBudget WRITE setMemoryBudget NOTIFY statsChanged)
+    /// Number of resident models, in use or idle
+    Q_PROPERTY(int residentModels READ residentModels NOTIFY statsChanged)
+    /// Requests served by a resident model
+    Q_PROPERTY(qint64 hits READ hits NOTIFY statsChanged)
+    /// Requests that had to load the model
+    Q_PROPERTY(qint64 misses READ misses NOTIFY statsChanged)
+public:
+    /// Shared context - the registry gets it back when the last copy is released
+    using Model = std::shared_ptr<whisper_context>;
+    /// Creates a new context and stores its size in bytes - nullptr on failure
+    using Loader = std::function<whisper_context *(qint64& size)>;
+    using Deleter = std::function<void (whisper_context *)>;
+
+    static constexpr qint64 DEFAULT_MEMORY_BUDGET = qint64{ 1 } << 30;
+
+    explicit ModelRegistry(qint64 memoryBudget = DEFAULT_MEMORY_BUDGET, Deleter deleter = whisper_free, QObject *parent = nullptr);
+    /// Frees the idle models - models still in use must be released before
+    ~ModelRegistry();
+
+    /// Registry shared by all the backends of the process
+    static ModelRegistry& instance();
+
+    /// Model loaded from \a path with \a ftype - calls \a load on a miss.
+    /// Concurrent requests for a model being loaded wait for it instead of loading another copy.
+    Model acquire(const QString& path, ggml_ftype ftype, const Loader& load);
+    /// Free all the idle models
+    void clear();
+
+    qint64 residentBytes() const;
+    qint64 memoryBudget() const;
+    void setMemoryBudget(qint64 bytes);
+    int residentModels() const;
+    qint64 hits() const;
+    qint64 misses() const;
+
+signals:
+    /// Always emitted in the thread of the registry - queued from the thread that changed the stats
+    void statsChanged();
+
+private:
+    struct Entry {
+        whisper_context *ctx = nullptr;
+        qint64 size = 0;
+        int refs = 0;
+        /// Value of the use counter at the last release - lower is older
+        quint64 lastUsed = 0;
+        bool loading = false;
+    };
+    static QString key(const QString& path, ggml_ftype ftype);
+    /// Emit statsChanged in the thread of the registry, whichever thread changed the stats
+    void notifyStats();
+    Model share(const QString& key, Entry& entry);
+    void release(const QString& key);
+    /// Take idle models out until the budget is met - the caller frees them outside of the lock
+    std::vector<whisper_context *> evict();
+    void freeContexts(const std::vector<whisper_context *>& contexts);
+
+    mutable QMutex _mutex;
+    QWaitCondition _loaded;
+    QHash<QString, Entry> _entries;
+    Deleter _deleter;
+    qint64 _memoryBudget;
+    qint64 _residentBytes = 0;
+    qint64 _hits = 0;
+    qint64 _misses = 0;
+    quint64 _useCounter = 0;
+};
+
+#endif // MODELREGISTRY_H
@@ -0,0 +1,71 @@
+#ifndef PIECESTITCHER_H
+#define PIECESTITCHER_H
+
+#include <QString>
+#include <deque>
+#include <optional>
+#include <utility>
+
+/// Joins the results of the pieces a long utterance is split into while it is still being captured.
+/// Results arrive in dispatch order - every piece but the last one of an utterance yields a partial text.
+class PieceStitcher
+{
+public:
+    struct Update {
+        QString text;
+        /// Whether the text is the whole utterance - a partial otherwise
+        bool final;
+    };
+
+    /// A piece was sent for inference - \a last marks the end of the utterance
+    void dispatched(bool last)
+    {
+        _pieces.push_back(last);
+    }
+
+    /// The utterance ended without a further piece, e.g. silence followed or the capture stopped.
+    /// Returns the final text if all of its pieces are decoded already, otherwise the last result in flight completes it.
+    std::optional<QString> end()
+    {
+        if (!_pieces.empty()) {
+            _pieces.back() = true;
+            return std::nullopt;
+        }
+        return std::exchange(_stitched, QString{ });
+    }
+
+    /// Result of the oldest piece in flight - results of inferences outside any utterance pass through as final
+    Update result(const QString& text)
+    {
+        if (_pieces.empty()) {
+            return { text, true };
+        }
+        const bool last = _pieces.front();
+        _pieces.pop_front();
+        _stitched += text;
+        if (!last) {
+            return { _stitched, false };
+        }
+        return { std::exchange(_stitched, QString{ }), true };
+    }
+
+    /// Text of the current utterance decoded so far
+    const QString& stitched() const
+    {
+        return _stitched;
+    }
+
+    /// Drop the pieces in flight and the text stitched so far
+    void clear()
+    {
+        _pieces.clear();
+        _stitched.clear();
+    }
+
+private:
+    /// Pieces waiting for their result - true for the last piece of an utterance
+    std::deque<bool> _pieces;
+    QString _stitched;
+};
+
+#endif // PIECESTITCHER_H
@@ -1,42 +1,76 @@
 #include "SpeechToText.h"
+#include "Trace.h"
 #include <QMediaDevices>
 #include <QAudioDevice>
 #include <QDebug>
+#include <QFile>
+#include <QResource>
+#include <QThreadPool>
 
 
 constexpr int SAMPLE_RATE = 16000;
 constexpr const char *MODEL_RESOURCE = ":/ggml-tiny-en-q4-0.bin";
 
-#define ASSERT_STATE(x) Q_ASSERT((updateState(),getState()) == x);
-
 SpeechToText::SpeechToText()
 {
 
     qRegisterMetaType<WhisperInfo::FloatType >();
     qRegisterMetaType<WhisperInfo::ModelType >();
-    qRegisterMetaType<std::vector<float> >();
-
+    qRegisterMetaType<AudioBuffer>("AudioBuffer");
+    // named threads show up as such in debuggers and exported traces
+    _whisperThread.setObjectName("whisper-backend");
 
     connect(this, &SpeechToText::modelPathChanged, this, &SpeechToText::loadModel);
-    ASSERT_STATE(State::NoModel);
+
+    // File and stream transcription
+    connect(&_transcriber, &FileTranscriber::segmentReady, this, [ = ](AudioBuffer samples){
+        _outstanding++;
+        _dispatched++;
+        auto r = QMetaObject::invokeMethod(_whisper, "threadedInference", Qt::QueuedConnection,
+        Q_ARG(AudioBuffer, samples));
+        if (!r) {
+            qFatal("Failed to invoke threaded inference");
+        }
+    });
+    connect(&_transcriber, &FileTranscriber::progress, this, &SpeechToText::transcriptionProgress);
+    connect(&_transcriber, &FileTranscriber::finished, this, &SpeechToText::transcriptionFinished);
+    connect(&_transcriber, &FileTranscriber::error, this, &SpeechToText::errorOccured);
+
+    // State transitions - every input of computeState() triggers an update when it changes
+    connect(&_transcriber, &FileTranscriber::finished, this, &SpeechToText::updateState);
+    connect(&_vad, &VoiceActivityDetector::voiceInProgressChanged, this, &SpeechToText::updateState);
+    connect(&_vad, &VoiceActivityDetector::adjustInProgressChanged, this, &SpeechToText::updateState);
+    connect(this, &SpeechToText::continuousChanged, this, &SpeechToText::updateState);
+    connect(this, &SpeechToText::modelUnloaded, this, &SpeechToText::updateState);
+
+    setCacheDirectory(ModelCache::defaultDirectory());
+    setCacheSizeLimitMb(ModelCache::DEFAULT_SIZE_LIMIT >> 20);
+    setInferenceWorkers(1);
+    setTargetRealTimeFactor(0.5);
+
+    // Sliding window defaults for streaming mode
+    setStreamStepMs(2000);
+    setStreamLengthMs(10000);
+    setStreamKeepMs(200);
 
     #ifdef EMBED_MODEL
     Q_INIT_RESOURCE(models);
+    if (QResource{ MODEL_RESOURCE }.compressionAlgorithm() != QResource::NoCompression) {
+        qWarning() << "Embedded model is compressed - it is unpacked to the heap on every load";
+    }
     setHasEmbeddedModel(true);
     setModelPath(MODEL_RESOURCE);
     #else
     setHasEmbeddedModel(false);
     #endif
-
-    //State UpdateTimers
-    _stateUpdateTimer.setInterval(30);
-    _stateUpdateTimer.callOnTimeout(this,&SpeechToText::updateState);
-    _stateUpdateTimer.start();
-
 }
 
 void SpeechToText::start()
 {
+    if (_source || _transcriber.isRunning()) {
+        // already listening or busy with a file
+        return;
+    }
     auto device = QMediaDevices::defaultAudioInput();
     QAudioFormat fmt;
 
@@ -46,39 +80,92 @@ void SpeechToText::start()
     fmt.setChannelCount(1);
 
     if (!device.isFormatSupported(fmt)) {
-        qDebug() << "Format " << fmt << " not supported";
+        // capture in the native format of the device and convert - most hardware runs at 44.1/48 kHz
+        fmt = device.preferredFormat();
+        if (fmt.sampleFormat() == QAudioFormat::Unknown) {
+            fmt.setSampleFormat(QAudioFormat::Int16);
+        }
+        qCDebug(lcCapture) << "Capturing in device format" << fmt;
     }
-
-
+    const bool native = fmt.sampleFormat() == QAudioFormat::Float && fmt.sampleRate() == SAMPLE_RATE
+                        && fmt.channelCount() == 1;
+    _converter.reset(native ? nullptr : new AudioConverter{ fmt, SAMPLE_RATE });
 
     _source.reset(new QAudioSource{ device, fmt });
     _audioDevice = _source->start();
-    ASSERT_STATE(State::WaitingForSpeech);
+    updateState();
     connect(_source.get(),&QAudioSource::stateChanged,this,[=](QAudio::State s){
-        qDebug() << "Audio source" << _source.get() << " state:" << s;
+        qCDebug(lcCapture) << "Audio source" << _source.get() << " state:" << s;
     });
     connect(_audioDevice, &QIODevice::readyRead, this, [ = ](){
-
-        auto bytes = _audioDevice->readAll();
-        float samples_count = bytes.size() / _source->format().bytesPerSample();
-        auto time_count     = samples_count / _source->format().sampleRate();
-        qDebug() << "Read " << bytes.size() << "bytes" << samples_count << "Samples" << time_count << "Seconds";
-        std::vector<float> frame{ reinterpret_cast<const float *>(bytes.cbegin()),
-                                  reinterpret_cast<const float *>(bytes.cend()) };
-
-        _vad.feedSamples(std::move(frame));
+        QTW_TRACE_SPAN(lcCapture, "capture");
+        qint64 bytes         = 0;
+        qint64 samples_count = 0;
+        if (_converter) {
+            // device format - converted block-wise into the pooled voice buffer, the capture buffer only grows
+            _captureBytes.resize(_audioDevice->bytesAvailable());
+            bytes = std::max<qint64>(_audioDevice->read(_captureBytes.data(), _captureBytes.size()), 0);
+            auto frame = _vad.prepareSamples(_converter->maxOutput(bytes));
+            samples_count = _converter->convert({ _captureBytes.data(), static_cast<size_t>(bytes) }, frame);
+        } else {
+            // Read straight into the pooled voice buffer of the detector - no intermediate copies
+            const auto bytes_per_sample = _source->format().bytesPerSample();
+            auto frame = _vad.prepareSamples(_audioDevice->bytesAvailable() / bytes_per_sample);
+            bytes         = _audioDevice->read(reinterpret_cast<char *>(frame.data()), frame.size_bytes());
+            samples_count = std::max<qint64>(bytes, 0) / bytes_per_sample;
+        }
+        auto time_count = static_cast<float>(samples_count) / SAMPLE_RATE;
+        qCDebug(lcCapture) << "Read " << bytes << "bytes" << samples_count << "Samples" << time_count << "Seconds";
+
+        _vad.commitSamples(samples_count);
+        // stream the speech accepted since the previous chunk
+        const auto voice = _vad.voiceSamples();
+        if (voice.size() < _streamed) {
+            _streamed = 0;
+        }
+        if (getStreaming() && _vad.getVoiceInProgress() && voice.size() > _streamed) {
+            streamSamples(voice.subspan(_streamed));
+        }
+        _streamed = voice.size();
     });
-    connect(&_vad, &VoiceActivityDetector::speechDetected, this, [ = ](std::vector<float> samples){
-        qDebug() << "Speech detected " << samples.size() << "samples";
-        QTimer::singleShot(1,this,&SpeechToText::stop);
-        auto r = QMetaObject::invokeMethod(_whisper, "threadedInference", Qt::QueuedConnection,
-        Q_ARG(std::vector<float>, samples));
-        if (!r) {
-            qFatal("Failed to invoke threaded inference");
+    connect(&_vad, &VoiceActivityDetector::speechDetected, this, [ = ](AudioBuffer samples){
+        qCDebug(lcVad) << "Speech detected " << samples.size() << "samples";
+        if (!getContinuous()) {
+            QTimer::singleShot(1,this,&SpeechToText::stop);
         }
+        // the final result supersedes any partial still in flight
+        _streamBuffer.clear();
+        _streamed = 0;
+        dispatchPiece(samples, true);
+    });
+    connect(&_vad, &VoiceActivityDetector::speechChunkDetected, this, [ = ](AudioBuffer samples){
+        qCDebug(lcVad) << "Speech chunk detected " << samples.size() << "samples";
+        // the chunk is decoded while the speaker goes on
+        _streamBuffer.clear();
+        _streamed = 0;
+        dispatchPiece(samples, false);
     });
 } // SpeechToText::start
 
+void SpeechToText::dispatchPiece(AudioBuffer samples, bool last)
+{
+    if (samples.isNull()) {
+        // only silence followed the previous piece - it ends the utterance
+        if (const auto text = _stitcher.end()) {
+            emit resultReady(*text);
+        }
+        return;
+    }
+    _stitcher.dispatched(last);
+    _outstanding++;
+    _dispatched++;
+    auto r = QMetaObject::invokeMethod(_whisper, "threadedInference", Qt::QueuedConnection,
+    Q_ARG(AudioBuffer, samples));
+    if (!r) {
+        qFatal("Failed to invoke threaded inference");
+    }
+}
+
 void SpeechToText::stop()
 {
     // immidieatly stop the audio recording
@@ -89,8 +176,109 @@ void SpeechToText::stop()
 
 
     // if waiting for speech - simply disconnect the slots
-    disconnect(&_vad,nullptr,this,nullptr);
+    disconnect(&_vad, &VoiceActivityDetector::speechDetected, this, nullptr);
+    disconnect(&_vad, &VoiceActivityDetector::speechChunkDetected, this, nullptr);
     _vad.reset();
+    _streamBuffer.clear();
+    _streamed       = 0;
+    _partialPending = false;
+    // a split utterance ends with the capture - the piece still in flight completes it
+    if (const auto text = _stitcher.end(); text && !text->isEmpty()) {
+        emit resultReady(*text);
+    }
+    updateState();
+}
+
+bool SpeechToText::transcribeFile(const QString &path)
+{
+    auto file = new QFile{ path };
+    if (!file->open(QIODeviceBase::ReadOnly)) {
+        emit errorOccured(QString{ "Failed to open %1: %2" }.arg(path, file->errorString()));
+        delete file;
+        return false;
+    }
+    return startTranscription(file, true);
+}
+
+bool SpeechToText::transcribeDevice(QIODevice *device)
+{
+    return startTranscription(device, false);
+}
+
+void SpeechToText::cancelTranscription()
+{
+    _transcriber.cancel();
+    cancelInference();
+    updateState();
+}
+
+void SpeechToText::cancel()
+{
+    // the work in flight is dropped first - stopping would finish the utterance in progress otherwise
+    cancelInference();
+    stop();
+    _transcriber.cancel();
+    updateState();
+}
+
+void SpeechToText::cancelInference()
+{
+    if (_whisper) {
+        _whisper->cancel();
+    }
+    // every dispatched piece still reports a (possibly empty) result - those are dropped
+    _discard      = _outstanding;
+    _discardBelow = _dispatched;
+    _stitcher.clear();
+    _streamBuffer.clear();
+    _partialPending = false;
+}
+
+bool SpeechToText::exportTrace(const QString &path)
+{
+    if (!qtw::trace::compiledIn()) {
+        qWarning() << "Tracing is not compiled in - configure with QT_WHISPER_TRACING=ON";
+        return false;
+    }
+    return qtw::trace::exportChromeTrace(path);
+}
+
+bool SpeechToText::startTranscription(QIODevice *device, bool owned)
+{
+    // the backend serves one audio source at a time
+    const auto state = getState();
+    if (state == State::NoModel || state == State::WaitingForModel || _source || _transcriber.isRunning()) {
+        qWarning() << "Cannot start transcription in state" << state;
+        if (owned) {
+            device->deleteLater();
+        }
+        return false;
+    }
+    const bool started = _transcriber.start(device, owned);
+    updateState();
+    return started;
+}
+
+void SpeechToText::streamSamples(std::span<const float> samples)
+{
+    if (_streamBuffer.isNull()) {
+        _streamBuffer = AudioPool::shared().acquire();
+    }
+    _streamBuffer.append(samples);
+
+    // Wait for the previous window to finish - the samples keep accumulating meanwhile
+    const auto step = static_cast<size_t>(getStreamStepMs()) * SAMPLE_RATE / 1000;
+    if (_partialPending || _streamBuffer.size() < step) {
+        return;
+    }
+    _partialPending = true;
+    auto r = QMetaObject::invokeMethod(_whisper, "streamInference", Qt::QueuedConnection,
+        Q_ARG(AudioBuffer, std::exchange(_streamBuffer, {})),
+        Q_ARG(int, getStreamLengthMs() * SAMPLE_RATE / 1000),
+        Q_ARG(int, getStreamKeepMs() * SAMPLE_RATE / 1000));
+    if (!r) {
+        qFatal("Failed to invoke stream inference");
+    }
 }
 
 SpeechToText::~SpeechToText()
@@ -105,7 +293,6 @@ void SpeechToText::loadModel(const QString &path)
     if (_whisper || getState() == State::Busy) {
         // Unload model before loading
         connect(this,&SpeechToText::modelUnloaded,this,[=](){
-                ASSERT_STATE(State::NoModel);
                 loadModel(path);
             },static_cast<Qt::ConnectionType>(Qt::AutoConnection | Qt::SingleShotConnection));
         unloadModel();
@@ -113,37 +300,102 @@ void SpeechToText::loadModel(const QString &path)
         return;
     }
     _whisper = new WhisperBackend(path);
+    _whisper->setCache(ModelCache{ getCacheDirectory(), qint64{ getCacheSizeLimitMb() } << 20 });
+    _whisper->setNumWorkers(getInferenceWorkers());
+    _whisper->setWarmUp(getWarmUp());
     _whisper->moveToThread(&_whisperThread);
 
 
     connect(_whisper, &WhisperBackend::resultReady, this, [ = ](auto s){
-        ASSERT_STATE(State::Ready);
-        emit resultReady(s);
+        _outstanding--;
+        if (_discard > 0) {
+            // result of a cancelled piece
+            _discard--;
+            return;
+        }
+        // results arrive in order - pieces of a long utterance are stitched together
+        const auto update = _stitcher.result(s);
+        if (!update.final) {
+            emit partialResultReady(update.text);
+            return;
+        }
+        emit resultReady(update.text);
+        // file transcription queues segments while earlier ones are decoded - release the next one
+        _transcriber.segmentDone();
+    });
+    connect(_whisper, &WhisperBackend::segmentReady, this, [ = ](quint64 utterance, QString text, qint64 startMs,
+                                                                 qint64 endMs){
+        if (utterance < _discardBelow) {
+            // segment of a cancelled piece, decoded before the cancel reached it
+            return;
+        }
+        emit segmentReady(utterance, text, startMs, endMs);
+    });
+    connect(_whisper, &WhisperBackend::partialResultReady, this, [ = ](auto s){
+        _partialPending = false;
+        // the window only covers the speech after the last dispatched piece - the partial is the utterance so far
+        emit partialResultReady(_stitcher.stitched() + s);
     });
     connect(_whisper, &WhisperBackend::error, this, [ = ](auto s){
-        ASSERT_STATE(State::Ready);
         emit SpeechToText::errorOccured(s);
     });
     connect(_whisper, &WhisperBackend::modelLoaded, this, &SpeechToText::backendInfoChanged);
+    connect(_whisper, &WhisperBackend::inferenceTimed, &_metrics, &InferenceMetrics::record);
+
+    // mirrors of the backend state - it lives in the whisper thread and is never read from here
+    connect(_whisper, &WhisperBackend::modelLoaded, this, [ = ](){
+        _modelReady = true;
+        updateState();
+    });
+    connect(_whisper, &WhisperBackend::busyChanged, this, [ = ](bool busy){
+        _backendBusy = busy;
+        updateState();
+    });
 
 
     QMetaObject::invokeMethod(_whisper, "loadModel", Qt::QueuedConnection);
+    if (getAutotune()) {
+        QMetaObject::invokeMethod(_whisper, "autotune", Qt::QueuedConnection,
+                                  Q_ARG(double, getTargetRealTimeFactor()), Q_ARG(bool, getAutotuneQuantization()));
+    }
 
 
     if (!_whisperThread.isRunning())
         _whisperThread.start();
-    ASSERT_STATE(State::WaitingForModel);
+    updateState();
+}
+
+void SpeechToText::preloadModel(const QString &path, WhisperInfo::FloatType ftype, const QString &cacheDirectory,
+                                int cacheSizeLimitMb)
+{
+    QThreadPool::globalInstance()->start([ = ](){
+        WhisperBackend backend{ path };
+        backend.setCache(ModelCache{ cacheDirectory, qint64{ cacheSizeLimitMb } << 20 });
+        backend.preloadModel(ftype);
+    });
 }
 
 void SpeechToText::unloadModel()
 {
+    // dropped before stopping - an utterance in progress is not finished with the results of this model
+    _stitcher.clear();
     stop();
+    _transcriber.cancel();
+    _modelReady  = false;
+    _backendBusy = false;
+    _outstanding  = 0;
+    _discard      = 0;
+    _dispatched   = 0;
+    _discardBelow = 0;
     if (_whisper)
     {
+        // the backend is deleted once its thread gets to it - free the CPU from the running work first
+        _whisper->cancel();
         disconnect(_whisper,nullptr,this,nullptr);
         connect(_whisper, &QObject::destroyed, this, &SpeechToText::modelUnloaded);
         _whisper->deleteLater();
     }
+    updateState();
 }
 
 const WhisperInfo *SpeechToText::getBackendInfo() const
@@ -152,15 +404,31 @@ const WhisperInfo *SpeechToText::getBackendInfo() const
     return _whisper->info();
 }
 
+ModelRegistry *SpeechToText::getModelRegistry() const
+{
+    return &ModelRegistry::instance();
+}
+
+InferenceMetrics *SpeechToText::getMetrics()
+{
+    return &_metrics;
+}
+
 SpeechToText::State SpeechToText::getState() const
+{
+    return _state;
+}
+
+SpeechToText::State SpeechToText::computeState() const
 {
 #define O(state, cond) \
     if(cond) return state
 
     // whisper related states
     O(State::NoModel, _whisper.isNull()); // No model is loaded, need to call loadModel first
-    O(State::WaitingForModel, _whisper->info()->getModelType()==WhisperInfo::MODEL_UNKNOWN); // Model is being loaded in the background thread
-    O(State::Busy,_whisper->getBusy()); // Model is performing inference in the background thread
+    O(State::WaitingForModel, !_modelReady); // Model is being loaded in the background thread
+    O(State::Busy,_backendBusy && !(getContinuous() && _source)); // Model is performing inference in the background thread (continuous capture takes precedence)
+    O(State::Busy,_transcriber.isRunning()); // A file or stream is being transcribed
 
     // VAD related states
     O(State::Tuning, _vad.getAdjustInProgress()); // VAD is listening for sound in order to adjust itself for background noise
@@ -175,14 +443,17 @@ SpeechToText::State SpeechToText::getState() const
 void SpeechToText::quantize(int mode)
 {
     Q_ASSERT(_whisper);
+    // the model is replaced - drop the work done with the current one
+    cancelInference();
     QMetaObject::invokeMethod(_whisper, "unloadModel", Qt::QueuedConnection);
     QMetaObject::invokeMethod(_whisper, "loadModel", Qt::QueuedConnection, static_cast<WhisperInfo::FloatType>(mode));
 }
 
 void SpeechToText::updateState()
 {
-    static State s = State::NoModel;
-    if(getState() != s){
-        emit stateChanged(getState());
+    const auto state = computeState();
+    if (state != _state) {
+        _state = state;
+        emit stateChanged(state);
     }
 }
@@ -9,6 +9,10 @@
 
 #include "WhisperBackend.h"
 #include "VoiceActivityDetector.h"
+#include "FileTranscriber.h"
+#include "AudioConverter.h"
+#include "ModelRegistry.h"
+#include "PieceStitcher.h"
 #include "QmlMacros.h"
 
 class SpeechToText : public QObject
@@ -29,29 +33,91 @@ public:
 private:
     QML_WRITABLE_PROPERTY(QString, modelPath, ModelPath)
     QML_READONLY_PROPERTY(bool, hasEmbeddedModel, HasEmbeddedModel)
+    /// Directory of the quantized model cache - empty disables the cache. Defaults to ModelCache::defaultDirectory(),
+    /// a qt-whisper folder in the per-user cache location
+    QML_WRITABLE_PROPERTY(QString, cacheDirectory, CacheDirectory)
+    /// Size limit of the quantized model cache in MiB
+    QML_WRITABLE_PROPERTY(int, cacheSizeLimitMb, CacheSizeLimitMb)
+    /// Utterances transcribed in parallel - every worker adds an inference state but shares the model weights
+    QML_WRITABLE_PROPERTY(int, inferenceWorkers, InferenceWorkers)
+    /// Tune threads and workers for this host after the model is loaded - overrides inferenceWorkers
+    QML_WRITABLE_PROPERTY(bool, autotune, Autotune)
+    /// Real time factor the autotune aims for - 0.5 means a second of speech is transcribed in half a second
+    QML_WRITABLE_PROPERTY(double, targetRealTimeFactor, TargetRealTimeFactor)
+    /// Let the autotune switch to a heavier quantization when the target is not met otherwise
+    QML_WRITABLE_PROPERTY(bool, autotuneQuantization, AutotuneQuantization)
+    /// Warm the inference states up with a short decode before reporting the model as loaded
+    QML_WRITABLE_PROPERTY(bool, warmUp, WarmUp)
+    /// Keep listening after an utterance is detected - utterances are queued for inference while capture continues
+    QML_WRITABLE_PROPERTY(bool, continuous, Continuous)
+    /// Emit partial results while speech is still in progress
+    QML_WRITABLE_PROPERTY(bool, streaming, Streaming)
+    /// How much new audio (in ms) is collected before the sliding window is re-decoded
+    QML_WRITABLE_PROPERTY(int, streamStepMs, StreamStepMs)
+    /// Length of the sliding window (in ms)
+    QML_WRITABLE_PROPERTY(int, streamLengthMs, StreamLengthMs)
+    /// How much audio (in ms) of the previous window is kept as context
+    QML_WRITABLE_PROPERTY(int, streamKeepMs, StreamKeepMs)
     Q_PROPERTY(const WhisperInfo * backendInfo READ getBackendInfo NOTIFY backendInfoChanged)
+    /// Models shared by all the instances - memory budget and hit statistics
+    Q_PROPERTY(ModelRegistry * modelRegistry READ getModelRegistry CONSTANT)
+    /// Timings, real time factor and their percentiles of the transcribed utterances - kept across model reloads
+    Q_PROPERTY(InferenceMetrics * metrics READ getMetrics CONSTANT)
     Q_PROPERTY(State state READ getState NOTIFY stateChanged)
 public:
     SpeechToText();
     Q_INVOKABLE void start();
     Q_INVOKABLE void stop();
+    /// Transcribe a recorded WAV file (or raw 16 kHz mono float samples) - results arrive through resultReady
+    Q_INVOKABLE bool transcribeFile(const QString& path);
+    /// Transcribe a WAV/PCM stream read from \a device, which has to stay open until transcriptionFinished
+    bool transcribeDevice(QIODevice *device);
+    /// Abort the running file or stream transcription, including the decodes already running
+    Q_INVOKABLE void cancelTranscription();
+    /// Stop capturing and abort everything in flight - queued and running decodes, streaming windows
+    /// and file transcription. The inference threads are free again after at most one encoder pass.
+    Q_INVOKABLE void cancel();
+    /// Write the pipeline spans recorded so far as a Chrome trace JSON file. Spans are recorded only for the
+    /// enabled qtw.* logging categories of a build with QT_WHISPER_TRACING - false otherwise or on write failure
+    Q_INVOKABLE bool exportTrace(const QString& path);
 
 
     ~SpeechToText();
+    /// Start loading the model at \a path in the background, e.g. in main() before the QML is loaded.
+    /// Instances loading the same model later share it - or wait for it if it is still loading.
+    /// Pass the cacheDirectory and cacheSizeLimitMb the instances use, so a quantized model is cached where they
+    /// look for it - the defaults match the defaults of the properties, an empty directory disables the cache.
+    static void preloadModel(const QString& path, WhisperInfo::FloatType ftype = GGML_FTYPE_ALL_F32,
+                             const QString& cacheDirectory = ModelCache::defaultDirectory(),
+                             int cacheSizeLimitMb = ModelCache::DEFAULT_SIZE_LIMIT >> 20);
     void loadModel(const QString& path);
     void unloadModel();
 
     const WhisperInfo *getBackendInfo() const;
+    ModelRegistry *getModelRegistry() const;
+    InferenceMetrics *getMetrics();
     State getState() const;
     Q_INVOKABLE void quantize(int mode);
 
 
 
 public slots:
+    /// Recompute the state and emit stateChanged if it differs - called whenever one of its inputs changes
     void updateState();
 
 signals:
     void resultReady(const QString& str);
+    /// Segment of an utterance still being transcribed - resultReady delivers the whole text afterwards.
+    /// \a utterance numbers the decoded pieces of speech in dispatch order since the model was loaded - segments
+    /// with the same number belong together, a long utterance split at pauses spans consecutive numbers.
+    /// Times are relative to the start of the decoded piece of speech
+    void segmentReady(quint64 utterance, const QString& text, qint64 startMs, qint64 endMs);
+    /// Hypothesis for the whole utterance in progress - the decoded pieces of a long utterance followed by the
+    /// streaming window over the speech after them. Confirmed later by resultReady
+    void partialResultReady(const QString& str);
+    /// Fraction of the file or stream transcribed so far
+    void transcriptionProgress(qreal fraction);
+    void transcriptionFinished();
     void modelUnloaded();
     void modelLoaded();
     void errorOccured(const QString& str);
@@ -60,14 +126,47 @@ signals:
     void backendInfoChanged();
 
 private:
+    void streamSamples(std::span<const float> samples);
+    State computeState() const;
+    bool startTranscription(QIODevice *device, bool owned);
+    /// Queue a piece of captured speech for inference - \a last marks the end of the utterance
+    void dispatchPiece(AudioBuffer samples, bool last);
+    /// Cancel the work of the backend and drop the results still to come
+    void cancelInference();
+
     QPointer<WhisperBackend> _whisper = nullptr;
     VoiceActivityDetector _vad;
     std::unique_ptr<QAudioSource> _source = nullptr;
-    std::vector<float> _audioBuffer;
+    /// Converts the capture format of the device - null if it delivers 16 kHz mono float itself
+    std::unique_ptr<AudioConverter> _converter;
+    /// Raw capture data waiting for conversion
+    std::vector<char> _captureBytes;
     QIODevice *_audioDevice = nullptr;
+    FileTranscriber _transcriber;
+    InferenceMetrics _metrics;
     bool _stopFlag = false;
+    /// Samples collected since the last partial inference was dispatched
+    AudioBuffer _streamBuffer;
+    /// Speech samples of the current segment already passed to the stream buffer
+    size_t _streamed = 0;
+    /// Pieces of the captured utterance in flight and their text decoded so far
+    PieceStitcher _stitcher;
+    /// Final inferences dispatched to the backend and not reported yet
+    int _outstanding = 0;
+    /// Results of cancelled inferences still to be dropped
+    int _discard = 0;
+    /// Final inferences dispatched to the current backend - the number of the next one
+    quint64 _dispatched = 0;
+    /// Inferences numbered below were cancelled - their segments are dropped
+    quint64 _discardBelow = 0;
+    /// Whether a partial inference is queued or running in the whisper thread
+    bool _partialPending = false;
     QThread _whisperThread;
-    QTimer _stateUpdateTimer;
+    State _state = State::NoModel;
+    /// The backend finished loading the model
+    bool _modelReady = false;
+    /// Last busy state reported by the backend
+    bool _backendBusy = false;
 };
 
 
@@ -0,0 +1,150 @@
+#include "Trace.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+Q_LOGGING_CATEGORY(lcCapture, "qtw.capture", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcVad, "qtw.vad", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcQueue, "qtw.queue", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcQuantization, "qtw.quantization", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcLoad, "qtw.load", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcInference, "qtw.inference", QtWarningMsg)
+
+namespace {
+/// Spans kept per thread - later ones are dropped until clear()
+constexpr size_t THREAD_CAPACITY = 1 << 16;
+
+struct Event {
+    const char *name;
+    const char *category;
+    qint64 begin;
+    qint64 end;
+};
+
+/// Written only by its own thread - the size is published after the event, so readers need no lock
+struct ThreadBuffer {
+    std::unique_ptr<Event[]> events{ new Event[THREAD_CAPACITY] };
+    std::atomic<size_t> size{ 0 };
+    std::atomic<size_t> dropped{ 0 };
+    int tid;
+    QString thread;
+};
+
+struct Registry {
+    QMutex mutex;
+    /// Buffers outlive their threads - the spans of finished threads are exported too
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+Registry& registry()
+{
+    static Registry r;
+    return r;
+}
+
+ThreadBuffer& local_buffer()
+{
+    // registration is the only locked step, once per thread
+    thread_local const std::shared_ptr<ThreadBuffer> buffer = []{
+        auto b = std::make_shared<ThreadBuffer>();
+        auto& r = registry();
+        QMutexLocker lock{ &r.mutex };
+        b->tid    = static_cast<int>(r.buffers.size()) + 1;
+        b->thread = QThread::currentThread()->objectName();
+        if (b->thread.isEmpty()) {
+            b->thread = QStringLiteral("thread %1").arg(b->tid);
+        }
+        r.buffers.push_back(b);
+        return b;
+    }();
+    return *buffer;
+}
+} // namespace
+
+namespace qtw::trace {
+
+qint64 now()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool compiledIn()
+{
+#ifdef QT_WHISPER_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+void record(const QLoggingCategory &category, const char *name, qint64 begin, qint64 end)
+{
+    auto& buffer = local_buffer();
+    const auto i = buffer.size.load(std::memory_order_relaxed);
+    if (i >= THREAD_CAPACITY) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.events[i] = Event{ name, category.categoryName(), begin, end };
+    buffer.size.store(i + 1, std::memory_order_release);
+}
+
+bool exportChromeTrace(const QString &path)
+{
+    QFile file{ path };
+    if (!file.open(QIODeviceBase::WriteOnly | QIODeviceBase::Text)) {
+        return false;
+    }
+    QTextStream out{ &file };
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    auto& r = registry();
+    QMutexLocker lock{ &r.mutex };
+    bool first = true;
+    auto separator = [&]() -> QTextStream& {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        return out;
+    };
+    for (const auto& buffer : r.buffers) {
+        auto thread = buffer->thread;
+        thread.replace('\\', '/').replace('"', '\'');
+        separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                    << ",\"args\":{\"name\":\"" << thread << "\"}}";
+
+        const auto n = buffer->size.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; i++) {
+            const auto& e = buffer->events[i];
+            // microseconds with fractions - Chrome trace time unit
+            separator() << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+                        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                        << ",\"ts\":" << QString::number(e.begin / 1000.0, 'f', 3)
+                        << ",\"dur\":" << QString::number((e.end - e.begin) / 1000.0, 'f', 3) << "}";
+        }
+        if (const auto dropped = buffer->dropped.load(std::memory_order_relaxed)) {
+            qWarning() << "Trace buffer of" << buffer->thread << "dropped" << dropped << "spans";
+        }
+    }
+    out << "\n]}\n";
+    return out.status() == QTextStream::Ok;
+}
+
+void clear()
+{
+    auto& r = registry();
+    QMutexLocker lock{ &r.mutex };
+    for (const auto& buffer : r.buffers) {
+        buffer->size.store(0, std::memory_order_release);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace qtw::trace
@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QLoggingCategory>
+#include <QString>
+
+/// Pipeline logging categories - debug output and trace spans of a category are off unless enabled,
+/// e.g. QT_LOGGING_RULES="qtw.*.debug=true"
+Q_DECLARE_LOGGING_CATEGORY(lcCapture)
+Q_DECLARE_LOGGING_CATEGORY(lcVad)
+Q_DECLARE_LOGGING_CATEGORY(lcQueue)
+Q_DECLARE_LOGGING_CATEGORY(lcQuantization)
+Q_DECLARE_LOGGING_CATEGORY(lcLoad)
+Q_DECLARE_LOGGING_CATEGORY(lcInference)
+
+namespace qtw::trace {
+
+/// Monotonic time in nanoseconds - the time base of all the spans
+qint64 now();
+/// Whether the library was built with QT_WHISPER_TRACING
+bool compiledIn();
+/// Record a span of \a category that ran from \a begin to \a end on the calling thread.
+/// \a name has to be a string literal - only the pointer is kept.
+void record(const QLoggingCategory& category, const char *name, qint64 begin, qint64 end);
+/// Write all the recorded spans as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+bool exportChromeTrace(const QString& path);
+/// Drop the recorded spans - call while the pipeline is idle
+void clear();
+
+/// Records the lifetime of the scope as a span, if the category is enabled
+class Span
+{
+public:
+    Span(const QLoggingCategory& category, const char *name)
+        : _category{ category.isDebugEnabled() ? &category : nullptr }, _name{name}, _begin{ _category ? now() : 0 }
+    { }
+    ~Span()
+    {
+        if (_category) {
+            record(*_category, _name, _begin, now());
+        }
+    }
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    const QLoggingCategory *_category;
+    const char *_name;
+    qint64 _begin;
+};
+
+} // namespace qtw::trace
+
+#ifdef QT_WHISPER_TRACING
+#define QTW_TRACE_CONCAT_(a, b) a ## b
+#define QTW_TRACE_CONCAT(a, b) QTW_TRACE_CONCAT_(a, b)
+/// Trace the rest of the enclosing scope
+#define QTW_TRACE_SPAN(category, name) const qtw::trace::Span QTW_TRACE_CONCAT(qtw_trace_span_, __LINE__){ category(), name }
+/// Trace a span measured elsewhere, e.g. one that started on another thread
+#define QTW_TRACE_COMPLETE(category, name, begin, end) \
+    do { if (category().isDebugEnabled()) qtw::trace::record(category(), name, begin, end); } while (0)
+#else
+#define QTW_TRACE_SPAN(category, name) do { } while (0)
+#define QTW_TRACE_COMPLETE(category, name, begin, end) do { } while (0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,126 @@
+#include "VadEngine.h"
+
+#include <cmath>
+#include <numbers>
+#include "vadkernels.h"
+
+namespace {
+constexpr size_t N = VadEngine::FRAME_SAMPLES;
+/// The real FFT runs as a complex FFT of half the size
+constexpr size_t M = N / 2;
+constexpr float BAND_LOW_HZ  = 200.0f;
+constexpr float BAND_HIGH_HZ = 4000.0f;
+} // namespace
+
+static_assert((N & (N - 1)) == 0, "The frame size has to be a power of two");
+static_assert(N % qtw::VAD_LANES == 0, "The frame size has to be a multiple of the kernel width");
+
+VadEngine::VadEngine()
+    : _window(N), _cos(M + 1), _sin(M + 1), _bitReverse(M), _windowed(N), _re(M + 1), _im(M + 1), _power(M + 1)
+{
+    const double pi = std::numbers::pi;
+    for (size_t i = 0; i < N; i++) {
+        // Hann
+        _window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2 * pi * i / N));
+    }
+    for (size_t k = 0; k <= M; k++) {
+        _cos[k] = static_cast<float>(std::cos(2 * pi * k / N));
+        _sin[k] = static_cast<float>(std::sin(2 * pi * k / N));
+    }
+    int bits = 0;
+    while ((size_t{ 1 } << bits) < M) {
+        bits++;
+    }
+    for (size_t i = 0; i < M; i++) {
+        size_t r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        _bitReverse[i] = static_cast<uint16_t>(r);
+    }
+    const float bin_hz = static_cast<float>(SAMPLE_RATE) / N;
+    _bandBegin = static_cast<size_t>(BAND_LOW_HZ / bin_hz);
+    _bandEnd   = static_cast<size_t>(BAND_HIGH_HZ / bin_hz) + 1;
+}
+
+VadFeatures VadEngine::analyze(std::span<const float> frame)
+{
+    VadFeatures features;
+    features.energy             = qtw::sum_squares(frame.data(), N) / N;
+    features.zero_crossing_rate = static_cast<float>(qtw::zero_crossings(frame.data(), N, _prev)) / N;
+    _prev = frame[N - 1];
+
+    spectrum(frame.data());
+    // the DC bin carries no information about speech
+    float total = 0.0f;
+    float band  = 0.0f;
+    for (size_t k = 1; k <= M; k++) {
+        total += _power[k];
+        band  += (k >= _bandBegin && k < _bandEnd) ? _power[k] : 0.0f;
+    }
+    features.band_ratio = total > 0.0f ? band / total : 0.0f;
+    return features;
+}
+
+void VadEngine::reset()
+{
+    _prev = 0.0f;
+}
+
+void VadEngine::spectrum(const float *frame)
+{
+    qtw::apply_window(frame, _window.data(), _windowed.data(), N);
+
+    // even samples go to the real part, odd to the imaginary part - in bit reversed order
+    for (size_t k = 0; k < M; k++) {
+        const auto r = _bitReverse[k];
+        _re[k] = _windowed[2 * r];
+        _im[k] = _windowed[2 * r + 1];
+    }
+
+    // iterative radix-2 complex FFT of size M; the twiddles of size M are every other one of size N
+    for (size_t len = 2; len <= M; len <<= 1) {
+        const size_t half = len / 2;
+        const size_t step = 2 * (M / len);
+        for (size_t i = 0; i < M; i += len) {
+            for (size_t j = 0; j < half; j++) {
+                const float wr = _cos[j * step];
+                const float wi = -_sin[j * step];
+                const size_t a = i + j;
+                const size_t b = a + half;
+                const float vr = _re[b] * wr - _im[b] * wi;
+                const float vi = _re[b] * wi + _im[b] * wr;
+                _re[b] = _re[a] - vr;
+                _im[b] = _im[a] - vi;
+                _re[a] += vr;
+                _im[a] += vi;
+            }
+        }
+    }
+
+    // split the spectra of the even and odd samples and combine them into the spectrum of the real frame
+    _re[M] = _re[0];
+    _im[M] = _im[0];
+    for (size_t k = 0; k <= M / 2; k++) {
+        const float a = _re[k];
+        const float b = _im[k];
+        const float c = _re[M - k];
+        const float d = _im[M - k];
+
+        const float even_re = (a + c) / 2;
+        const float even_im = (b - d) / 2;
+        const float odd_re  = (b + d) / 2;
+        const float odd_im  = (c - a) / 2;
+        // X[k] = E[k] + W^k O[k], X[M - k] = conj(E[k]) - conj(W^k O[k]) mirrored
+        const float wr = _cos[k];
+        const float wi = -_sin[k];
+        const float t_re = wr * odd_re - wi * odd_im;
+        const float t_im = wr * odd_im + wi * odd_re;
+
+        _re[k]     = even_re + t_re;
+        _im[k]     = even_im + t_im;
+        _re[M - k] = even_re - t_re;
+        _im[M - k] = t_im - even_im;
+    }
+    qtw::power_spectrum(_re.data(), _im.data(), _power.data(), M + 1);
+}
@@ -0,0 +1,53 @@
+#ifndef VADENGINE_H
+#define VADENGINE_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/// Features of one audio frame used by the voice activity detection
+struct VadFeatures {
+    /// Mean energy of the samples
+    float energy;
+    /// Share of neighbouring samples with a sign change - high for hiss and fricatives, low for voiced speech
+    float zero_crossing_rate;
+    /// Share of the spectral energy in the speech band (200 - 4000 Hz)
+    float band_ratio;
+};
+
+/// Computes VadFeatures of fixed-size frames of 16 kHz mono audio.
+/// All the buffers are allocated once - analyzing a frame does not touch the heap.
+class VadEngine
+{
+public:
+    /// Samples per frame - 16 ms at 16 kHz, also the size of the real FFT
+    static constexpr size_t FRAME_SAMPLES = 256;
+    static constexpr int SAMPLE_RATE = 16000;
+    static constexpr int FRAME_MS = FRAME_SAMPLES * 1000 / SAMPLE_RATE;
+
+    VadEngine();
+
+    /// Features of \a frame, which holds exactly FRAME_SAMPLES samples
+    VadFeatures analyze(std::span<const float> frame);
+    /// Forget the last sample of the previous frame
+    void reset();
+
+private:
+    /// Power spectrum of the windowed frame in _power (FRAME_SAMPLES / 2 + 1 bins)
+    void spectrum(const float *frame);
+
+    std::vector<float> _window;
+    /// cos/sin of 2*pi*k/FRAME_SAMPLES for k in [0, FRAME_SAMPLES / 2]
+    std::vector<float> _cos;
+    std::vector<float> _sin;
+    std::vector<uint16_t> _bitReverse;
+    std::vector<float> _windowed;
+    std::vector<float> _re;
+    std::vector<float> _im;
+    std::vector<float> _power;
+    size_t _bandBegin;
+    size_t _bandEnd;
+    float _prev = 0.0f;
+};
+
+#endif // VADENGINE_H
@@ -1,24 +1,101 @@
 #include "VoiceActivityDetector.h"
+#include "Trace.h"
 #include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
 VoiceActivityDetector::VoiceActivityDetector(const Params& params, QObject *parent)
     : QObject{parent}, _params{params}, _patience_counter{params.patience},
     _detected_samples_counter{params.minimum_samples}, _adjustment_counter{params.adjust_samples}
 {
-    qRegisterMetaType<std::vector<float> >();
+    qRegisterMetaType<AudioBuffer>("AudioBuffer");
+    _carry.reserve(VadEngine::FRAME_SAMPLES);
+}
+
+void VoiceActivityDetector::feedSamples(std::span<const float> data)
+{
+    auto dst = prepareSamples(data.size());
+    std::copy(data.begin(), data.end(), dst.begin());
+    commitSamples(data.size());
+}
+
+std::span<float> VoiceActivityDetector::prepareSamples(size_t n)
+{
+    if (_voice_buffer.isNull()) {
+        _voice_buffer = AudioPool::shared().acquire();
+    }
+    _voice_buffer.resize(_committed + _pending);
+    return _voice_buffer.grow(n);
 }
 
-void VoiceActivityDetector::feedSamples(const std::vector<float> &data)
+void VoiceActivityDetector::commitSamples(size_t n)
+{
+    QTW_TRACE_SPAN(lcVad, "vad");
+    constexpr size_t frame_size = VadEngine::FRAME_SAMPLES;
+    _voice_buffer.resize(_committed + _pending + n);
+    _pending += n;
+
+    // frames are classified in place - frames outside of speech are dropped by moving the next ones over them
+    size_t read = _committed;
+    while (_pending >= frame_size) {
+        auto samples = _voice_buffer.data();
+        if (read != _committed) {
+            std::copy(samples + read, samples + read + frame_size, samples + _committed);
+        }
+        const bool keep = processFrame({ samples + _committed, frame_size });
+        read     += frame_size;
+        _pending -= frame_size;
+        if (keep) {
+            _committed += frame_size;
+        }
+
+        // if patience runs out, signal speech detection and continue in a new buffer
+        if (_patience_counter <= 0 && getVoiceInProgress()) {
+            const auto pending = _pending;
+            _carry.assign(samples + read, samples + read + pending);
+            _voice_buffer.resize(_committed);
+            endSegment();
+            _voice_buffer = AudioPool::shared().acquire();
+            _voice_buffer.append(_carry);
+            _pending = pending;
+            read     = 0;
+        } else if (splitDue()) {
+            // long speech - hand over what we have while the speaker goes on
+            _carry.assign(samples + read, samples + read + _pending);
+            _voice_buffer.resize(_committed);
+            emit speechChunkDetected(_voice_buffer);
+            _voice_buffer = AudioPool::shared().acquire();
+            _voice_buffer.append(_carry);
+            _committed     = 0;
+            _voiced_frames = 0;
+            read           = 0;
+        }
+    }
+
+    // keep the unfinished frame right after the speech
+    auto samples = _voice_buffer.data();
+    if (read != _committed) {
+        std::copy(samples + read, samples + read + _pending, samples + _committed);
+    }
+    _voice_buffer.resize(_committed + _pending);
+}// VoiceActivityDetector::commitSamples
+
+bool VoiceActivityDetector::processFrame(std::span<const float> frame)
 {
+    const auto features = _engine.analyze(frame);
+
     _adjustment_counter = std::max(_adjustment_counter - 1, 0);
     if (_adjustment_counter > 0) {
         setAdjustInProgress(true);
-        adjust(data);
-        return;
+        adjust(frame);
+        return false;
     }
     setAdjustInProgress(false);
 
-    auto energy = std::inner_product(data.begin(), data.end(), data.begin(), 0.0f) / data.size();
-    const bool current_score = energy > threshold();
+    const bool current_score = features.energy > _threshold
+                               && features.band_ratio >= _params.min_band_ratio
+                               && features.zero_crossing_rate <= _params.max_zero_crossing_rate;
 
     if (current_score) {
         // reset patience
@@ -26,8 +103,9 @@ void VoiceActivityDetector::feedSamples(const std::vector<float> &data)
 
         // start the new potential segment if not already started
         setVoiceInProgress(true);
+        _voiced_frames++;
 
-        // count consecutive accepted samples
+        // count consecutive accepted frames
         if (--_detected_samples_counter < 0) {
             _segment_approved = true;
         }
@@ -35,52 +113,81 @@ void VoiceActivityDetector::feedSamples(const std::vector<float> &data)
         // decrement patience counter
         _patience_counter = std::max(_patience_counter - 1, 0);
 
-        // reset accepted samples counter
+        // reset accepted frames counter
         _detected_samples_counter = _params.minimum_samples;
     }
 
-    // Capture voice if speech is detected
-    if (getVoiceInProgress()) {
-        _voice_buffer.insert(_voice_buffer.end(), data.begin(), data.end());
-    }
+    // Capture voice if speech is detected - otherwise drop the frame
+    return getVoiceInProgress();
+}
 
+std::span<const float> VoiceActivityDetector::voiceSamples() const
+{
+    return _voice_buffer.samples().first(_committed);
+}
 
-    // if patience runs out, signal speech detection and reset buffers
-    if (_patience_counter <= 0 && getVoiceInProgress()) {
-        if (_segment_approved) {
-            emit speechDetected(_voice_buffer);
-        }
-        reset();
+bool VoiceActivityDetector::splitDue() const
+{
+    if (!getVoiceInProgress() || !_segment_approved) {
+        return false;
+    }
+    const auto frames  = static_cast<int>(_committed / VadEngine::FRAME_SAMPLES);
+    const auto silence = _params.patience - _patience_counter;
+    return frames >= _params.max_segment
+           || (frames >= _params.split_after && silence >= _params.split_pause);
+}
+
+void VoiceActivityDetector::endSegment()
+{
+    if (_segment_approved) {
+        // a remainder of silence after the last split carries no speech - only the end is signalled
+        emit speechDetected(_voiced_frames > 0 ? _voice_buffer : AudioBuffer{ });
     }
-    qDebug() << "Energy: " << energy << "Threshold: " <<threshold()<<" Speech:" << getVoiceInProgress() << " Patience:" << _patience_counter
-             << " Valid counter:" << _detected_samples_counter;
-}// VoiceActivityDetector::feedSamples
+    reset();
+}
 
 void VoiceActivityDetector::reset()
 {
-    _voice_buffer.clear();
+    // the emitted buffer may still be in use - the next segment takes a fresh block from the pool
+    _voice_buffer  = AudioBuffer{ };
+    _committed     = 0;
+    _pending       = 0;
+    _voiced_frames = 0;
+    _engine.reset();
     setVoiceInProgress(false);
     _segment_approved         = false;
     _patience_counter         = _params.patience;
     _detected_samples_counter = _params.minimum_samples;
 }
 
-void VoiceActivityDetector::adjust(const std::vector<float> &data)
+void VoiceActivityDetector::flush()
+{
+    if (getVoiceInProgress()) {
+        // the unfinished frame is dropped
+        _voice_buffer.resize(_committed);
+        endSegment();
+        return;
+    }
+    reset();
+}
+
+void VoiceActivityDetector::adjust(std::span<const float> data)
 {
     auto energy = std::inner_product(data.begin(), data.end(), data.begin(), 0.0f) / data.size();
     auto diff   = std::abs(energy - _mean_energy);
 
     _mean_energy = _mean_energy * _params.beta + (1 - _params.beta) * energy;
     _std_energy  = _std_energy * _params.beta + (1 - _params.beta) * diff;
-}
-
-float VoiceActivityDetector::threshold() const
-{
 
     // Expecting exponential distribution
     // Tukey anomaly criterion
     auto lambda = 1/_mean_energy;
-    return 2*std::log(10)/lambda;
+    _threshold  = 2*std::log(10)/lambda;
+}
+
+float VoiceActivityDetector::threshold() const
+{
+    return _threshold;
 }
 
 VoiceActivityDetector::Params VoiceActivityDetector::defaultParams()
@@ -90,6 +197,11 @@ VoiceActivityDetector::Params VoiceActivityDetector::defaultParams()
         50, // minimum samples
         0.5f, // tuning coefficient
         4.0f, // treshold coefficient
-        200
+        200, // adjust frames
+        0.3f, // minimum speech band ratio
+        0.45f, // maximum zero crossing rate
+        10000 / VadEngine::FRAME_MS, // split after 10 s
+        200 / VadEngine::FRAME_MS, // at a 200 ms pause
+        28000 / VadEngine::FRAME_MS // hard cap just below the 30 s whisper window
     };
 }
@@ -2,33 +2,57 @@
 #define VOICEACTIVITYDETECTOR_H
 
 #include <QObject>
+#include <span>
+#include "AudioPool.h"
+#include "VadEngine.h"
 #include "QmlMacros.h"
 
+/// Energy based voice activity detection. Input of any chunk size is cut into fixed frames of
+/// VadEngine::FRAME_SAMPLES samples, so the endpointing latency does not depend on the audio backend.
 class VoiceActivityDetector : public QObject
 {
     Q_OBJECT
     QML_READONLY_PROPERTY(bool, voiceInProgress, VoiceInProgress)
     QML_READONLY_PROPERTY(bool, adjustInProgress, AdjustInProgress)
 public:
+    /// Counts are in frames of VadEngine::FRAME_MS milliseconds
     struct Params {
-        /// Longest streak of samples with no voice before speech is considered to have ended
+        /// Longest streak of frames with no voice before speech is considered to have ended
         int   patience;
-        /// Minimum streak of samples with speach for a segment to be considered as containing speech
+        /// Minimum streak of frames with speach for a segment to be considered as containing speech
         int   minimum_samples;
         /// Tuning coefficient - higher coefficient requires longer tuning
         float beta;
         /// Treshold coeffitient - real threashold is calculated by mean(E) + k*std(E)
         float threshold;
-        /// How many samples from the beginning of audio should be used for tuning
+        /// How many frames from the beginning of audio should be used for tuning
         int   adjust_samples;
+        /// Minimum share of the frame energy in the speech band
+        float min_band_ratio;
+        /// Maximum zero crossing rate of a voiced frame - rejects hiss
+        float max_zero_crossing_rate;
+        /// Speech longer than this is split at the next pause
+        int   split_after;
+        /// Shortest streak of silent frames to split long speech at
+        int   split_pause;
+        /// Speech is split at this length even without a pause
+        int   max_segment;
     };
     explicit VoiceActivityDetector(const Params& params = defaultParams(), QObject *parent = nullptr);
     /// Feed series of samples to the detection
-    void feedSamples(const std::vector<float>& data);
+    void feedSamples(std::span<const float> data);
+    /// Reserve space for n samples at the end of the voice buffer - capture can read straight into it
+    std::span<float> prepareSamples(size_t n);
+    /// Run the detection on the first n samples written to the span returned by prepareSamples
+    void commitSamples(size_t n);
+    /// Speech collected so far
+    std::span<const float> voiceSamples() const;
     /// Reset the speech detection state
     void reset();
+    /// End of input - emit the speech in progress as if patience ran out
+    void flush();
     /// Adjust the treshold of speech detection assuming that the given data is background noise
-    void adjust(const std::vector<float>& data);
+    void adjust(std::span<const float> data);
     /// Current speech threshold calculated from the background noise
     float threshold() const;
     /// Default parameters for the Voice Activity Detector
@@ -37,9 +61,19 @@ public slots:
 
 
 signals:
-    /// Fired when the given samples are considered to contain speech
-    void speechDetected(std::vector<float> samples);
+    /// Fired when the speech has ended with its samples since the last speechChunkDetected.
+    /// The buffer is null if nothing but silence followed the last chunk.
+    void speechDetected(AudioBuffer samples);
+    /// Fired for a piece of long speech that is still in progress - the pieces are consecutive
+    void speechChunkDetected(AudioBuffer samples);
 private:
+    /// Run the detection on one frame - returns whether the frame belongs to the speech segment
+    bool processFrame(std::span<const float> frame);
+    /// Emit the segment if it was approved and start a new one
+    void endSegment();
+    /// Whether the speech in progress is long enough to be split here
+    bool splitDue() const;
+
     /// Parameters passed in during construction
     Params _params;
     /// Internal counter for patience
@@ -48,8 +82,19 @@ private:
     int _detected_samples_counter = 0;
     /// Wether a given speech segment (a series of samples) was approved as speech.
     bool _segment_approved = false;
-    /// Buffer for storing speech samples
-    std::vector<float> _voice_buffer;
+    /// Pooled buffer for storing speech samples - incoming samples are written past its committed end
+    AudioBuffer _voice_buffer;
+    /// Number of samples in the voice buffer that belong to the speech segment
+    size_t _committed = 0;
+    /// Voiced frames in the voice buffer
+    int _voiced_frames = 0;
+    /// Samples past the committed ones waiting for a complete frame
+    size_t _pending = 0;
+    /// Samples of an unfinished frame carried over to the buffer of the next segment
+    std::vector<float> _carry;
+    VadEngine _engine;
+    /// Speech threshold - updated only while adjusting
+    float _threshold = 0;
     /// Current mean sample energy for background noise
     float _mean_energy = 0;
     /// Current standard deviation of energy for background noise
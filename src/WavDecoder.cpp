@@ -0,0 +1,145 @@
+#include "WavDecoder.h"
+
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+constexpr quint16 WAVE_FORMAT_PCM        = 0x0001;
+constexpr quint16 WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+constexpr quint16 WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+} // namespace
+
+WavDecoder::WavDecoder(QIODevice &device) : _device{device}
+{ }
+
+bool WavDecoder::open()
+{
+    const auto riff = _device.peek(12);
+    if (riff.size() < 12 || !riff.startsWith("RIFF") || riff.mid(8, 4) != "WAVE") {
+        // No header - raw whisper input
+        _format.setSampleFormat(QAudioFormat::Float);
+        _format.setSampleRate(16000);
+        _format.setChannelCount(1);
+        _dataSize = _device.isSequential() ? -1 : _device.size() - _device.pos();
+        return true;
+    }
+    _device.skip(12);
+
+    bool has_format = false;
+    QByteArray id;
+    quint32 size = 0;
+    while (readChunkHeader(id, size)) {
+        if (id == "fmt ") {
+            const auto fmt = _device.read(size);
+            if (fmt.size() < 16) {
+                _error = "Truncated fmt chunk";
+                return false;
+            }
+            auto format_tag     = qFromLittleEndian<quint16>(fmt.constData());
+            const auto channels = qFromLittleEndian<quint16>(fmt.constData() + 2);
+            const auto rate     = qFromLittleEndian<quint32>(fmt.constData() + 4);
+            const auto bits     = qFromLittleEndian<quint16>(fmt.constData() + 14);
+            if (format_tag == WAVE_FORMAT_EXTENSIBLE && fmt.size() >= 26) {
+                // the actual format is in the first two bytes of the sub-format GUID
+                format_tag = qFromLittleEndian<quint16>(fmt.constData() + 24);
+            }
+
+            QAudioFormat::SampleFormat sample_format = QAudioFormat::Unknown;
+            if (format_tag == WAVE_FORMAT_PCM) {
+                switch (bits) {
+                case 8: sample_format = QAudioFormat::UInt8;
+                    break;
+                case 16: sample_format = QAudioFormat::Int16;
+                    break;
+                case 32: sample_format = QAudioFormat::Int32;
+                    break;
+                }
+            } else if (format_tag == WAVE_FORMAT_IEEE_FLOAT && bits == 32) {
+                sample_format = QAudioFormat::Float;
+            }
+            if (sample_format == QAudioFormat::Unknown || channels == 0 || rate == 0) {
+                _error = QString{ "Unsupported WAV format %1 with %2 bits per sample" }.arg(format_tag).arg(bits);
+                return false;
+            }
+            _format.setSampleFormat(sample_format);
+            _format.setSampleRate(static_cast<int>(rate));
+            _format.setChannelCount(channels);
+            has_format = true;
+            if (size & 1) {
+                _device.skip(1);
+            }
+        } else if (id == "data") {
+            if (!has_format) {
+                _error = "WAV data chunk before the fmt chunk";
+                return false;
+            }
+            // streamed WAV files often leave the size unset
+            _dataSize = (size == 0 || size == 0xFFFFFFFF) ? -1 : size;
+            return true;
+        } else {
+            // chunks are padded to an even size
+            _device.skip(size + (size & 1));
+        }
+    }
+    _error = "No data chunk in WAV stream";
+    return false;
+} // WavDecoder::open
+
+QAudioFormat WavDecoder::format() const
+{
+    return _format;
+}
+
+qint64 WavDecoder::dataSize() const
+{
+    return _dataSize;
+}
+
+qint64 WavDecoder::bytesRead() const
+{
+    return _bytesRead;
+}
+
+qint64 WavDecoder::read(char *data, qint64 maxSize)
+{
+    if (atEnd()) {
+        return -1;
+    }
+    if (_dataSize >= 0) {
+        maxSize = std::min(maxSize, _dataSize - _bytesRead);
+    }
+    // only whole frames - the remainder stays in the device for the next call
+    const int frame = _format.bytesPerFrame();
+    maxSize -= maxSize % frame;
+
+    const auto n = _device.read(data, maxSize);
+    if (n < 0) {
+        return -1;
+    }
+    _bytesRead += n;
+    return n;
+}
+
+bool WavDecoder::atEnd() const
+{
+    if (_dataSize >= 0 && _bytesRead >= _dataSize) {
+        return true;
+    }
+    return !_device.isSequential() && _device.atEnd();
+}
+
+QString WavDecoder::errorString() const
+{
+    return _error;
+}
+
+bool WavDecoder::readChunkHeader(QByteArray &id, quint32 &size)
+{
+    const auto header = _device.read(8);
+    if (header.size() < 8) {
+        return false;
+    }
+    id   = header.left(4);
+    size = qFromLittleEndian<quint32>(header.constData() + 4);
+    return true;
+}
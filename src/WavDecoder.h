@@ -0,0 +1,38 @@
+#ifndef WAVDECODER_H
+#define WAVDECODER_H
+
+#include <QAudioFormat>
+#include <QIODevice>
+
+/// Incremental WAV reader - parses the RIFF header and then hands out the raw frames of the data chunk
+/// piece by piece, so a recording never has to be loaded into memory as a whole.
+/// Streams without a RIFF header are treated as raw 16 kHz mono 32-bit float PCM.
+class WavDecoder
+{
+public:
+    explicit WavDecoder(QIODevice& device);
+
+    /// Parse the header - the device has to be open for reading
+    bool open();
+    /// Format of the frames returned by read()
+    QAudioFormat format() const;
+    /// Size of the audio data in bytes, -1 if unknown
+    qint64 dataSize() const;
+    /// Bytes of audio data read so far
+    qint64 bytesRead() const;
+    /// Read up to maxSize bytes of interleaved frames. Returns -1 at the end of the data.
+    qint64 read(char *data, qint64 maxSize);
+    bool atEnd() const;
+    QString errorString() const;
+
+private:
+    bool readChunkHeader(QByteArray& id, quint32& size);
+
+    QIODevice& _device;
+    QAudioFormat _format;
+    qint64 _dataSize = -1;
+    qint64 _bytesRead = 0;
+    QString _error;
+};
+
+#endif // WAVDECODER_H
@@ -1,17 +1,84 @@
 #include "WhisperBackend.h"
 
+#include <algorithm>
+#include <limits>
 #include <numeric>
 #include <functional>
 
 #include <QDebug>
+#include <QBuffer>
 #include <QFile>
 #include <QRegularExpression>
-#include <QBuffer>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QScopeGuard>
+#include <QThread>
+#include <QSettings>
+#include <QSysInfo>
+#include <QFileInfo>
 
 #include "quantization.h"
+#include "processinfo.h"
+#include "ModelRegistry.h"
+#include "Trace.h"
+#include "decodetimeline.h"
+
+namespace {
+constexpr int SAMPLE_RATE = 16000;
+/// Length of the calibration audio - the tuned real time factor holds for utterances of this length
+constexpr int CALIBRATION_SECONDS = 5;
+/// Tokens decoded per calibration run - noise would otherwise decode to an arbitrary amount of text
+constexpr int CALIBRATION_TOKENS = 32;
+/// Length of the warm-up audio - whisper pads it to a full window, so every buffer gets touched anyway
+constexpr int WARMUP_SECONDS = 1;
+
+/// Faint pseudo random noise - deterministic so calibration runs are comparable. Unlike silence it makes the
+/// decoder run a few steps.
+std::vector<float> noise_samples(int seconds)
+{
+    std::vector<float> samples(seconds * SAMPLE_RATE);
+    quint32 seed = 1;
+    for (auto& sample : samples) {
+        seed   = seed * 1664525u + 1013904223u;
+        sample = (static_cast<float>(seed >> 8) / (1 << 24) - 0.5f) * 0.02f;
+    }
+    return samples;
+}
+
+/// Feeds the whisper model loader straight from a quantizer, mirroring the model into the cache on the way
+struct QuantizingLoader {
+    qtw::Quantizer& quantizer;
+    std::unique_ptr<QSaveFile> cacheFile;
+    /// Size of the quantized model handed to whisper
+    qint64 bytes = 0;
+
+    whisper_model_loader loader()
+    {
+        whisper_model_loader loader;
+        loader.context = this;
+        loader.read    = [](void *ctx, void *output, size_t read_size) -> size_t {
+            auto self = static_cast<QuantizingLoader *>(ctx);
+            auto data = static_cast<char *>(output);
+            const auto n = self->quantizer.read(data, read_size);
+            self->bytes += n;
+            if (self->cacheFile) {
+                self->cacheFile->write(data, n);
+            }
+            // whisper does not check for short reads - never leave it with garbage
+            std::memset(data + n, 0, read_size - n);
+            return n;
+        };
+        loader.eof = [](void *ctx) {
+            return static_cast<QuantizingLoader *>(ctx)->quantizer.atEnd();
+        };
+        loader.close = [](void *) { };
+        return loader;
+    }
+};
+} // namespace
 
 WhisperBackend::WhisperBackend(const QString& filePath, QObject *parent)
-    : _numThreads{2}
+    : _numThreads{std::min(4, QThread::idealThreadCount())}, _numWorkers{1}
 {
     setBusy(true);
     _og_filepath = filePath;
@@ -25,73 +92,427 @@ WhisperBackend::~WhisperBackend()
 
 void WhisperBackend::loadModel(WhisperInfo::FloatType ftype)
 {
+    // the only owner of busy while loading - a failed load must not leave the owner waiting
     setBusy(true);
-    qDebug() << "load model called with quantization type: " << ftype;
+    const bool loaded = load(ftype);
+    setBusy(false);
+    if (loaded) {
+        emit modelLoaded();
+    }
+}
+
+bool WhisperBackend::load(WhisperInfo::FloatType ftype)
+{
+    QTW_TRACE_SPAN(lcLoad, "load model");
+    qCDebug(lcLoad) << "load model called with quantization type: " << ftype;
     _params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
     _params.progress_callback = [] (whisper_context *ctx, whisper_state *state, int progress, void *user_data){
-          qDebug() << "Inference progress: " << progress;
+          qCDebug(lcInference) << "Inference progress: " << progress;
       };
 
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+
+    // Backends using the same model share its weights - only a miss loads (and quantizes) it
+    QString failure;
+    _model = ModelRegistry::instance().acquire(_og_filepath, ftype, [&](qint64& size){
+        return createContext(ftype, size, failure);
+    });
+    _ctx = _model.get();
+    if (_ctx == nullptr && cancelToken().cancelled()) {
+        // superseded by an unload or another model - not an error
+        return false;
+    }
+    if (_ctx == nullptr) {
+        emit error(failure.isEmpty() ? QString{ "Failed to initialize whisper context" } : failure);
+        return false;
+    }
+    _streamState = whisper_init_state(_ctx);
+    if (_streamState == nullptr || !createPool()) {
+        unloadModel();
+        emit error("Failed to allocate whisper inference state");
+        return false;
+    }
+    _ftype = ftype;
+    collectInfo();
+    _info.setLoadTimeMs(loadTimer.elapsed());
+    if (getWarmUp()) {
+        QElapsedTimer warmUpTimer;
+        warmUpTimer.start();
+        warmUp();
+        _info.setWarmUpTimeMs(warmUpTimer.elapsed());
+    }
+    _info.setPeakMemory(qtw::peak_rss_bytes());
+    qCDebug(lcLoad) << "Model loaded in" << _info.getLoadTimeMs() << "ms, warm-up:" << _info.getWarmUpTimeMs()
+                    << "ms, peak RSS:" << (_info.getPeakMemory() >> 20) << "MiB";
+    return true;
+} // WhisperBackend::load
+
+bool WhisperBackend::preloadModel(WhisperInfo::FloatType ftype)
+{
+    QTW_TRACE_SPAN(lcLoad, "preload model");
+    QString failure;
+    // released right away - the registry keeps it resident as long as the memory budget allows
+    const auto model = ModelRegistry::instance().acquire(_og_filepath, ftype, [&](qint64& size){
+        return createContext(ftype, size, failure);
+    });
+    if (!model) {
+        qWarning() << "Failed to preload" << _og_filepath << failure;
+    }
+    return model != nullptr;
+}
+
+whisper_context *WhisperBackend::createContext(WhisperInfo::FloatType ftype, qint64 &size, QString &failure) const
+{
+    // Initialize whisper straight from the mapped file - the weights are not copied to the heap first.
+    // Uncompressed resources map to their place in the binary, so the embedded model is read in place as well.
+    // The context holds only the weights, inference states are created for the workers.
+    auto init_from_file = [](QFile& f) -> whisper_context * {
+        const auto size = f.size();
+        if (auto mapped = f.map(0, size)) {
+            auto ctx = whisper_init_from_buffer_no_state(mapped, size);
+            // the weights were copied into the context tensors - the mapping is not needed anymore
+            f.unmap(mapped);
+            return ctx;
+        }
+        auto bytes = f.readAll();
+        return whisper_init_from_buffer_no_state(bytes.data(), bytes.size());
+    };
+
     QFile file{ _og_filepath };
     file.open(QIODeviceBase::ReadOnly);
-    QByteArray bytes;
 
+    whisper_context *ctx = nullptr;
     if (ftype == GGML_FTYPE_ALL_F32) {
-        bytes = file.readAll();
+        ctx  = init_from_file(file);
+        size = file.size();
+    } else if (const auto cached = _cache.lookup(_og_filepath, ftype); !cached.isEmpty()) {
+        // quantized before - skip the quantization
+        QFile cachedFile{ cached };
+        cachedFile.open(QIODeviceBase::ReadOnly);
+        ctx  = init_from_file(cachedFile);
+        size = cachedFile.size();
     } else {
-        QBuffer buffer;
-        buffer.open(QBuffer::WriteOnly);
-        auto err = qtw::buffer_quantize(file, buffer, ftype);
-        buffer.close();
-        if (err != 0) {
-            emit error(QString{ "Model quantization failed with code: %1" }.arg(err));
-            return;
+        // Quantize while loading - tensors are quantized ahead of the loader asking for them,
+        // mirrored to the cache and never collected into one buffer.
+        // A mapped model (or uncompressed embedded resource) is quantized in place, without reading it to the heap.
+        QByteArray mapped;
+        QBuffer mappedInput{ &mapped };
+        QIODevice *input = &file;
+        if (auto data = file.map(0, file.size())) {
+            mapped = QByteArray::fromRawData(reinterpret_cast<const char *>(data), file.size());
+            mappedInput.open(QIODeviceBase::ReadOnly);
+            input = &mappedInput;
+        }
+        qtw::Quantizer quantizer{ *input, ftype };
+        quantizer.setCancelToken(cancelToken());
+        QuantizingLoader source{ quantizer, _cache.storeWriter(_og_filepath, ftype) };
+        auto loader = source.loader();
+        ctx = whisper_init_no_state(&loader);
+
+        if (quantizer.error() == qtw::Quantizer::CANCELLED) {
+            whisper_free(ctx);
+            failure = "Model loading cancelled";
+            return nullptr;
+        }
+        if (quantizer.error() != 0) {
+            whisper_free(ctx);
+            failure = QString{ "Model quantization failed with code: %1" }.arg(quantizer.error());
+            return nullptr;
+        }
+        size = source.bytes;
+        if (ctx && source.cacheFile) {
+            // whisper stops at the last tensor - store whatever trails it as well
+            while (!quantizer.atEnd()) {
+                source.cacheFile->write(quantizer.next());
+            }
+            _cache.commit(*source.cacheFile);
         }
-        bytes = buffer.buffer();
     }
     file.close();
+    return ctx;
+} // WhisperBackend::createContext
 
-    _ctx = whisper_init_from_buffer(bytes.data(), bytes.size());
-
-    if (_ctx == nullptr) {
-        emit error("Failed to initialize whisper context");
-        return;
-    }
-    collectInfo();
+void WhisperBackend::cancel()
+{
+    _cancelGeneration.fetch_add(1, std::memory_order_relaxed);
+    // calls queued before this point are cancelled as well - the marker tells them apart from later ones
+    QMetaObject::invokeMethod(this, [ = ](){
+        _cancelHandled++;
+    }, Qt::QueuedConnection);
+}
 
-    setBusy(false);
-    emit modelLoaded();
-} // WhisperBackend::loadModel
+CancelToken WhisperBackend::cancelToken() const
+{
+    // taken at the last handled cancel - a pending cancel marker makes the token cancelled right away
+    return CancelToken{ &_cancelGeneration, _cancelHandled };
+}
 
 void WhisperBackend::unloadModel()
 {
-    whisper_free(_ctx);
+    // waits for the running decodes - they read the weights
+    _pool.reset();
+    whisper_free_state(_streamState);
+    _streamState = nullptr;
+    // the registry keeps the weights warm for the next user
+    _model.reset();
     _ctx = nullptr;
 }
 
-void WhisperBackend::threadedInference(std::vector<float> samples)
+void WhisperBackend::autotune(double targetRtf, bool allowQuantization)
 {
     setBusy(true);
-    if (whisper_full_parallel(_ctx, _params, samples.data(), static_cast<int>(samples.size()), getNumThreads()) != 0) {
-        fprintf(stderr, "failed to process audio\n");
+    // candidates are loaded silently - the owner hears of the weights the tuning settles on, and of its end,
+    // however it ends
+    const auto initialFtype = _ftype;
+    const auto done = qScopeGuard([this, initialFtype](){
+        setBusy(false);
+        if (_ctx && _ftype != initialFtype) {
+            emit modelLoaded();
+        }
+        emit autotuneFinished();
+    });
+    if (!_ctx) {
+        emit error("No model loaded");
+        return;
+    }
+
+    QSettings settings{ QSettings::IniFormat, QSettings::UserScope, "qt-whisper", "autotune" };
+    const QFileInfo model{ _og_filepath };
+    // one entry per host, model and tuning goal
+    settings.beginGroup(QStringLiteral("%1-%2-%3").arg(QSysInfo::machineHostName(), QSysInfo::currentCpuArchitecture())
+                        .arg(QThread::idealThreadCount()));
+    settings.beginGroup(QStringLiteral("%1-%2-%3-%4").arg(model.fileName()).arg(model.size()).arg(targetRtf)
+                        .arg(allowQuantization ? "q" : "noq"));
+
+    if (settings.contains("threads")) {
+        const auto ftype = static_cast<WhisperInfo::FloatType>(settings.value("ftype").toInt());
+        applyTuning(settings.value("threads").toInt(), settings.value("workers").toInt(), ftype);
+        _info.setRealTimeFactor(settings.value("rtf").toDouble());
+        qCDebug(lcInference) << "Using stored tuning:" << getNumThreads() << "threads," << getNumWorkers() << "workers," << ftype;
+        return;
+    }
+
+    // heavier quantization is only tried when the loaded weights miss the target
+    QList<WhisperInfo::FloatType> candidates{ _ftype };
+    if (allowQuantization && _info.requantizable()) {
+        for (auto ftype : { GGML_FTYPE_MOSTLY_Q8_0, GGML_FTYPE_MOSTLY_Q5_1, GGML_FTYPE_MOSTLY_Q4_0 }) {
+            if (ftype != _ftype) {
+                candidates << ftype;
+            }
+        }
     }
 
+    // powers of two up to the core count, and the core count itself
+    const int cores = QThread::idealThreadCount();
+    QList<int> threadCounts;
+    for (int threads = 1; threads < cores; threads *= 2) {
+        threadCounts << threads;
+    }
+    threadCounts << cores;
+    int best_threads = getNumThreads();
+    double best_rtf  = std::numeric_limits<double>::max();
+    auto best_ftype  = _ftype;
+    for (auto ftype : candidates) {
+        if (ftype != _ftype) {
+            applyTuning(getNumThreads(), getNumWorkers(), ftype);
+            if (!_ctx) {
+                break;
+            }
+        }
+        // the fewest threads meeting the target leave the most cores for parallel workers
+        for (int threads : threadCounts) {
+            if (cancelToken().cancelled()) {
+                break;
+            }
+            const auto rtf = calibrate(threads);
+            qCDebug(lcInference) << "Calibration:" << ftype << threads << "threads, RTF:" << rtf;
+            if (rtf < best_rtf) {
+                best_rtf     = rtf;
+                best_threads = threads;
+                best_ftype   = ftype;
+            }
+            if (rtf <= targetRtf) {
+                break;
+            }
+        }
+        if (best_rtf <= targetRtf) {
+            break;
+        }
+    }
+
+    if (!_ctx || cancelToken().cancelled()) {
+        // an interrupted calibration is not worth remembering
+        return;
+    }
+
+    const int workers = std::max(1, cores / best_threads);
+    applyTuning(best_threads, workers, best_ftype);
+    _info.setRealTimeFactor(best_rtf);
+    qCDebug(lcInference) << "Tuned to" << best_threads << "threads," << workers << "workers," << best_ftype << "RTF:" << best_rtf;
+
+    settings.setValue("threads", best_threads);
+    settings.setValue("workers", workers);
+    settings.setValue("ftype", static_cast<int>(best_ftype));
+    settings.setValue("rtf", best_rtf);
+} // WhisperBackend::autotune
+
+void WhisperBackend::threadedInference(AudioBuffer samples)
+{
+    // the utterance is final - next streaming window starts from scratch
+    _streamWindow.clear();
+    _utterances++;
+    if (!_pool) {
+        emit error("No model loaded");
+        // every dispatched utterance reports a result
+        emit resultReady(QString{ });
+        return;
+    }
+
+    setBusy(true);
+    auto params = _params;
+    params.n_threads = getNumThreads();
+    // the result is reported through the pool once a worker is done
+    _pool->submit(samples, params, cancelToken());
+}
+
+void WhisperBackend::streamInference(AudioBuffer samples, int lengthSamples, int keepSamples)
+{
+    const auto cancel = cancelToken();
+    if (!_streamState || cancel.cancelled()) {
+        return;
+    }
+    // keep the tail of the previous window so the words cut at its edge get decoded again
+    const auto take = std::min<qsizetype>(_streamWindow.size(),
+                                          std::max<qsizetype>(0, keepSamples + lengthSamples - static_cast<qsizetype>(samples.size())));
+    _streamWindow.erase(_streamWindow.begin(), _streamWindow.end() - take);
+    _streamWindow.insert(_streamWindow.end(), samples.data(), samples.data() + samples.size());
+
+    // Partial hypotheses are short lived - skip the context and decode the window as one segment
+    auto params = _params;
+    params.single_segment = true;
+    params.no_context     = true;
+    params.n_threads      = getNumThreads();
+    qtw::DecodeTimeline timeline;
+    timeline.cancel = cancel;
+    timeline.install(params);
+    if (whisper_full_with_state(_ctx, _streamState, params, _streamWindow.data(), static_cast<int>(_streamWindow.size())) != 0) {
+        qCWarning(lcInference) << "Failed to process streaming window";
+    }
+    if (cancel.cancelled()) {
+        return;
+    }
+
+    emit partialResultReady(collectSegments(_streamState));
+}
+
+const WhisperInfo *WhisperBackend::info() const
+{
+    return &_info;
+}
+
+QString WhisperBackend::collectSegments(whisper_state *state) const
+{
     QString s;
-    const int n_seg = whisper_full_n_segments(_ctx);
+    const int n_seg = whisper_full_n_segments_from_state(state);
     for (int i = 0; i < n_seg; i++) {
-        const char *text = whisper_full_get_segment_text(_ctx, i);
+        const char *text = whisper_full_get_segment_text_from_state(state, i);
         s.append(text);
     }
+    return s;
+}
 
-    setBusy(false);
-    setLastResult(s);
+bool WhisperBackend::createPool()
+{
+    _pool = std::make_unique<InferencePool>(_ctx, getNumWorkers());
+    // the pool numbers its utterances from 0 - the old one reported all of its own while it was destroyed
+    _poolBase = _utterances;
+    if (_pool->workers() == 0) {
+        return false;
+    }
+    // the pool also reports while it is destroyed - _pool already points elsewhere then
+    connect(_pool.get(), &InferencePool::resultReady, this, [ = , pool = _pool.get()](quint64, QString s){
+        setBusy(pool->pending() > 0);
+        setLastResult(s);
+        emit resultReady(s);
+    });
+    connect(_pool.get(), &InferencePool::segmentReady, this, [ = , base = _poolBase](quint64 sequence, QString text,
+                                                                                    qint64 startMs, qint64 endMs){
+        emit segmentReady(base + sequence, text, startMs, endMs);
+    });
+    connect(_pool.get(), &InferencePool::timingReady, this, &WhisperBackend::inferenceTimed);
+    return true;
+}
+
+double WhisperBackend::calibrate(int threads)
+{
+    const auto samples = noise_samples(CALIBRATION_SECONDS);
 
-    emit resultReady(s);
+    auto state = whisper_init_state(_ctx);
+    if (!state) {
+        return std::numeric_limits<double>::max();
+    }
+    auto params = _params;
+    params.n_threads        = threads;
+    params.no_context       = true;
+    params.single_segment   = true;
+    params.max_tokens       = CALIBRATION_TOKENS;
+    params.progress_callback = nullptr;
+    qtw::DecodeTimeline timeline;
+    timeline.cancel = cancelToken();
+    timeline.install(params);
+
+    // the first run warms up the caches - the best of the rest counts
+    qint64 best_ns = std::numeric_limits<qint64>::max();
+    QElapsedTimer timer;
+    for (int run = 0; run < 3 && !timeline.cancel.cancelled(); run++) {
+        timer.start();
+        whisper_full_with_state(_ctx, state, params, samples.data(), static_cast<int>(samples.size()));
+        if (run > 0) {
+            best_ns = std::min(best_ns, timer.nsecsElapsed());
+        }
+    }
+    whisper_free_state(state);
+    return best_ns / 1e9 / CALIBRATION_SECONDS;
 }
 
-const WhisperInfo *WhisperBackend::info() const
+void WhisperBackend::warmUp()
 {
-    return &_info;
+    QTW_TRACE_SPAN(lcLoad, "warm up");
+    const auto samples = noise_samples(WARMUP_SECONDS);
+    auto params = _params;
+    params.n_threads         = getNumThreads();
+    params.no_context        = true;
+    params.single_segment    = true;
+    params.max_tokens        = CALIBRATION_TOKENS;
+    params.progress_callback = nullptr;
+
+    // the workers warm up in parallel while this thread runs the streaming state
+    _pool->warmUp(samples, params, cancelToken());
+    qtw::DecodeTimeline timeline;
+    timeline.cancel = cancelToken();
+    timeline.install(params);
+    whisper_full_with_state(_ctx, _streamState, params, samples.data(), static_cast<int>(samples.size()));
+    _pool->waitForWarmUp();
+}
+
+void WhisperBackend::applyTuning(int threads, int workers, WhisperInfo::FloatType ftype)
+{
+    setNumThreads(threads);
+    setNumWorkers(workers);
+    if (ftype != _ftype || !_ctx) {
+        unloadModel();
+        load(ftype);
+        return;
+    }
+    if (_pool && _pool->workers() != workers) {
+        createPool();
+    }
+}
+
+void WhisperBackend::setCache(const ModelCache &cache)
+{
+    _cache = cache;
 }
 
 void WhisperBackend::collectInfo()
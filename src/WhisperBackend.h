@@ -1,7 +1,12 @@
 #pragma once
 #include <QObject>
+#include <atomic>
 #include "whisper.h"
 #include "ggml.h"
+#include "AudioPool.h"
+#include "InferencePool.h"
+#include "CancelToken.h"
+#include "ModelCache.h"
 #include "QmlMacros.h"
 
 class WhisperInfo : public QObject {
@@ -27,6 +32,14 @@ public:
 private:
     QML_READONLY_PROPERTY(ModelType, modelType, ModelType)
     QML_READONLY_PROPERTY(FloatType, floatType, FloatType)
+    /// Time it took to load (and quantize) the model
+    QML_READONLY_PROPERTY(qint64, loadTimeMs, LoadTimeMs)
+    /// Peak resident memory of the process after the model was loaded, in bytes
+    QML_READONLY_PROPERTY(qint64, peakMemory, PeakMemory)
+    /// Time the warm-up decodes took after loading - 0 without warm-up
+    QML_READONLY_PROPERTY(qint64, warmUpTimeMs, WarmUpTimeMs)
+    /// Real time factor measured by the last autotune - decode time divided by audio duration
+    QML_READONLY_PROPERTY(double, realTimeFactor, RealTimeFactor)
     Q_PROPERTY(bool requantizable READ requantizable NOTIFY floatTypeChanged)
     Q_PROPERTY(QString modelTypeString READ modelTypeString NOTIFY modelTypeChanged)
     Q_PROPERTY(QString floatTypeString READ floatTypeString NOTIFY floatTypeChanged)
@@ -36,27 +49,91 @@ private:
 class WhisperBackend : public QObject {
     Q_OBJECT
     QML_READONLY_PROPERTY(bool, busy, Busy)
+    /// Threads used by one decode
     QML_WRITABLE_PROPERTY(int, numThreads, NumThreads)
+    /// Utterances decoded in parallel - each worker holds its own inference state, the weights are shared
+    QML_WRITABLE_PROPERTY(int, numWorkers, NumWorkers)
+    /// Run a short decode on every inference state before modelLoaded, so the first real request
+    /// does not pay for cold caches and first-touch allocations
+    QML_WRITABLE_PROPERTY(bool, warmUp, WarmUp)
     QML_READONLY_PROPERTY(QString, lastResult, LastResult)
 public:
     WhisperBackend(const QString &filePath, QObject *parent = nullptr);
     ~WhisperBackend();
     Q_INVOKABLE void loadModel(WhisperInfo::FloatType = GGML_FTYPE_ALL_F32);
     Q_INVOKABLE void unloadModel();
-    Q_INVOKABLE void threadedInference(std::vector<float> samples);
+    /// Load the model into the shared registry without creating inference states - a later loadModel
+    /// with the same float type only picks it up. Returns whether the model could be loaded.
+    Q_INVOKABLE bool preloadModel(WhisperInfo::FloatType = GGML_FTYPE_ALL_F32);
+    /// Cancel the running and queued work - decodes, model quantization and autotune. Thread safe, to be called
+    /// directly rather than queued. Decodes stop at the next encoder pass or decoder step and report an empty result,
+    /// a quantizing load stops at the next tensor. Work queued after the call is not affected.
+    void cancel();
+    /// Find the threads per decode, workers and (if \a allowQuantization) quantization type meeting \a targetRtf
+    /// on this host with short calibration decodes. The choice is stored per host and model and reused next time.
+    /// Reports autotuneFinished however it ends, and modelLoaded once if the chosen weights differ from the loaded ones.
+    Q_INVOKABLE void autotune(double targetRtf, bool allowQuantization = false);
+    /// Decode an utterance - every call reports exactly one resultReady, in call order, even if the decode
+    /// fails, is cancelled or the model is unloaded meanwhile
+    Q_INVOKABLE void threadedInference(AudioBuffer samples);
+    /// Slide the streaming window by the given samples and decode it
+    Q_INVOKABLE void streamInference(AudioBuffer samples, int lengthSamples, int keepSamples);
     const WhisperInfo *info() const;
+    /// Cache used for quantized models - has to be set before the backend is moved to its thread
+    void setCache(const ModelCache& cache);
     static int bufferQuantize(QIODevice & in, QIODevice & out, ggml_ftype type);
 signals:
+    /// Complete text of an utterance
     void resultReady(QString result);
+    /// Segment of the utterance being decoded, before its resultReady - times relative to the utterance start.
+    /// \a utterance numbers the threadedInference calls of this backend from 0 - with several workers
+    /// segments of different utterances interleave.
+    void segmentReady(quint64 utterance, QString text, qint64 startMs, qint64 endMs);
+    void partialResultReady(QString result);
     void error(QString s);
     void modelLoaded();
+    void autotuneFinished();
+    /// Timings of every final decode - streaming partials are not included
+    void inferenceTimed(InferenceTiming timing);
 private:
+    /// Load the model and create the inference states - busy and modelLoaded are left to the caller
+    bool load(WhisperInfo::FloatType ftype);
     void collectInfo();
+    bool createPool();
+    /// Real time factor of a calibration decode with the given threads
+    double calibrate(int threads);
+    void warmUp();
+    /// Apply a tuning, reloading the weights without announcing them when the quantization changes
+    void applyTuning(int threads, int workers, WhisperInfo::FloatType ftype);
+    /// Load the model file - called by the registry on a miss
+    whisper_context *createContext(WhisperInfo::FloatType ftype, qint64& size, QString& failure) const;
+    QString collectSegments(whisper_state *state) const;
+    /// Token for work started now in the backend thread
+    CancelToken cancelToken() const;
 
 
     QString _og_filepath;
+    ModelCache _cache;
 
+    /// Weights shared through the model registry
+    std::shared_ptr<whisper_context> _model;
     whisper_context *_ctx = nullptr;
+    /// Float type requested for the loaded model
+    WhisperInfo::FloatType _ftype = GGML_FTYPE_ALL_F32;
+    /// Workers for final inference - created with the model
+    std::unique_ptr<InferencePool> _pool;
+    /// State for partial results of the streaming window
+    whisper_state *_streamState = nullptr;
     whisper_full_params _params;
+    /// Audio of the current streaming window
+    std::vector<float> _streamWindow;
     WhisperInfo _info;
+    /// threadedInference calls so far - the number of the next utterance
+    quint64 _utterances = 0;
+    /// Utterance submitted as sequence 0 of the current pool
+    quint64 _poolBase = 0;
+    /// Bumped by every cancel()
+    std::atomic<quint64> _cancelGeneration{ 0 };
+    /// Cancels whose marker was processed by the backend thread
+    quint64 _cancelHandled = 0;
 };
@@ -0,0 +1,55 @@
+#ifndef AUDIOKERNELS_H
+#define AUDIOKERNELS_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace qtw {
+
+/// Width of the resampler kernels - filters are padded to a multiple of it. As with the VAD kernels,
+/// independent partial sums let the compiler vectorize without reassociating floating point math.
+constexpr size_t RESAMPLE_LANES = 8;
+
+/// Dot product of \a n samples - \a n has to be a multiple of RESAMPLE_LANES
+inline float dot_product(const float *x, const float *h, size_t n)
+{
+    float acc[RESAMPLE_LANES] = { };
+    for (size_t i = 0; i < n; i += RESAMPLE_LANES) {
+        for (size_t j = 0; j < RESAMPLE_LANES; j++) {
+            acc[j] += x[i + j] * h[i + j];
+        }
+    }
+    float sum = 0.0f;
+    for (auto a : acc) {
+        sum += a;
+    }
+    return sum;
+}
+
+/// Average the \a channels of \a frames interleaved samples of type T into mono floats: (v + offset) * scale.
+/// The input needs no alignment - the loads compile to plain (unaligned) moves.
+template<typename T>
+inline void downmix(const char *in, size_t frames, int channels, float offset, float scale, float *out)
+{
+    if (channels == 1) {
+        for (size_t i = 0; i < frames; i++) {
+            T v;
+            std::memcpy(&v, in + i * sizeof(T), sizeof(T));
+            out[i] = (static_cast<float>(v) + offset) * scale;
+        }
+        return;
+    }
+    const float channel_scale = scale / channels;
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++) {
+            T v;
+            std::memcpy(&v, in + (i * channels + c) * sizeof(T), sizeof(T));
+            sum += static_cast<float>(v) + offset;
+        }
+        out[i] = sum * channel_scale;
+    }
+}
+
+} // namespace qtw
+#endif // AUDIOKERNELS_H
@@ -0,0 +1,70 @@
+#ifndef DECODETIMELINE_H
+#define DECODETIMELINE_H
+#include <cmath>
+#include "whisper.h"
+#include "../CancelToken.h"
+#include "../Trace.h"
+
+namespace qtw {
+
+/// Timestamps (qtw::trace::now()) of the phases of one whisper_full call, taken from the whisper callbacks.
+/// The mel spectrogram is computed before the encoder starts and decoding starts with the first logits.
+/// The same callbacks are the cancellation checkpoints of the decode.
+struct DecodeTimeline {
+    qint64 start        = 0;
+    qint64 encode_begin = 0;
+    qint64 decode_begin = 0;
+    qint64 end          = 0;
+    /// Once cancelled no further window is encoded and the running decoder is driven to the end token
+    CancelToken cancel;
+
+    /// Hook the timeline into \a params - it has to outlive the whisper_full call
+    void install(whisper_full_params& params)
+    {
+        params.encoder_begin_callback = [](whisper_context *, whisper_state *, void *user_data) {
+            auto self = static_cast<DecodeTimeline *>(user_data);
+            if (self->encode_begin == 0) {
+                self->encode_begin = trace::now();
+            }
+            // returning false stops whisper_full before the next encoder pass
+            return !self->cancel.cancelled();
+        };
+        params.encoder_begin_callback_user_data = this;
+        params.logits_filter_callback = [](whisper_context *ctx, whisper_state *, const whisper_token_data *, int,
+                                           float *logits, void *user_data) {
+            auto self = static_cast<DecodeTimeline *>(user_data);
+            if (self->decode_begin == 0) {
+                self->decode_begin = trace::now();
+            }
+            if (self->cancel.cancelled()) {
+                // only the end token is left - the segment ends with the next sampled token
+                const int n_vocab = whisper_n_vocab(ctx);
+                const int eot     = whisper_token_eot(ctx);
+                for (int i = 0; i < n_vocab; i++) {
+                    if (i != eot) {
+                        logits[i] = -INFINITY;
+                    }
+                }
+            }
+        };
+        params.logits_filter_callback_user_data = this;
+#ifdef QT_WHISPER_HAS_ABORT_CALLBACK
+        // newer whisper.cpp checks this between the graph computations as well
+        params.abort_callback = [](void *user_data) {
+            return static_cast<DecodeTimeline *>(user_data)->cancel.cancelled();
+        };
+        params.abort_callback_user_data = this;
+#endif
+    }
+
+    bool complete() const
+    {
+        return start > 0 && encode_begin >= start && decode_begin >= encode_begin && end >= decode_begin;
+    }
+    qint64 mel_ns() const { return encode_begin - start; }
+    qint64 encode_ns() const { return decode_begin - encode_begin; }
+    qint64 decode_ns() const { return end - decode_begin; }
+};
+
+} // namespace qtw
+#endif // DECODETIMELINE_H
@@ -0,0 +1,41 @@
+#ifndef PROCESSINFO_H
+#define PROCESSINFO_H
+#include <QtGlobal>
+
+#if defined(Q_OS_WIN)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace qtw {
+
+/// Peak resident set size of the process in bytes, 0 if the platform does not report it
+inline qint64 peak_rss_bytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.PeakWorkingSetSize);
+    }
+#elif defined(Q_OS_UNIX)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(Q_OS_DARWIN)
+        // reported in bytes
+        return static_cast<qint64>(usage.ru_maxrss);
+#else
+        // reported in kilobytes
+        return static_cast<qint64>(usage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return 0;
+}
+
+} // namespace qtw
+#endif // PROCESSINFO_H
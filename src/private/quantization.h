@@ -2,7 +2,20 @@
 #define QUANTIZATION_H
 #include <ggml.h>
 #include <QIODevice>
+#include <QBuffer>
 #include <QRegularExpression>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include "../CancelToken.h"
+#include "../Trace.h"
 
 namespace qtw {
 
@@ -39,9 +52,23 @@ struct TensorHeader {
         out.write(name.constData(), name_len);
 
     }
+    /// Serialize the header into \a out, reusing its capacity
+    void write(QByteArray& out) const
+    {
+        out.resize(0);
+        out.append(reinterpret_cast<const char *>(&n_dims), sizeof(n_dims));
+        out.append(reinterpret_cast<const char *>(&name_len), sizeof(name_len));
+        out.append(reinterpret_cast<const char *>(&ttype), sizeof(ttype));
+        out.append(reinterpret_cast<const char *>(dims.data()), dims.size() * sizeof(int32_t));
+        out.append(name.constData(), name_len);
+    }
+    int64_t n_elements() const
+    {
+        return std::reduce(dims.begin(), dims.end(), int64_t{ 1 }, std::multiplies{ });
+    }
 };
 
-quantizer_func get_quantizer(ggml_type t){
+inline quantizer_func get_quantizer(ggml_type t){
     switch(t){
     case GGML_TYPE_Q4_0:
         return ggml_quantize_q4_0;
@@ -58,26 +85,261 @@ quantizer_func get_quantizer(ggml_type t){
     }
 }
 
-void write_through(QIODevice& in, QIODevice& out, size_t n)
+inline void write_through(QIODevice& in, QIODevice& out, size_t n)
 {
     auto written = out.write(in.read(n));
     Q_ASSERT(written == n);
 }
 
-int buffer_quantize(QIODevice& in, QIODevice& out, ggml_ftype ftype)
+/// Time spent in the quantization stages in nanoseconds. Conversion and quantization run on the pool,
+/// so they are summed over all the worker threads and may exceed the wall time.
+struct QuantizerStats {
+    /// Reading the source model
+    std::atomic<qint64> read_ns{ 0 };
+    /// F16 -> F32 conversion
+    std::atomic<qint64> convert_ns{ 0 };
+    /// Quantization kernels
+    std::atomic<qint64> quantize_ns{ 0 };
+    /// Writing the quantized model
+    std::atomic<qint64> write_ns{ 0 };
+
+    void reset()
+    {
+        read_ns = convert_ns = quantize_ns = write_ns = 0;
+    }
+};
+
+/// Adds the time spent in its scope to a stage counter - does nothing if no stats are collected
+class StageTimer {
+public:
+    explicit StageTimer(std::atomic<qint64> *counter) : _counter{counter}
+    {
+        if (_counter) {
+            _timer.start();
+        }
+    }
+    ~StageTimer()
+    {
+        if (_counter) {
+            _counter->fetch_add(_timer.nsecsElapsed(), std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::atomic<qint64> *_counter;
+    QElapsedTimer _timer;
+};
+
+/// Decides which tensors get quantized. The name patterns are compiled once into a single expression per list,
+/// so every tensor costs one name conversion and two matches regardless of the list lengths.
+class TensorClassifier {
+public:
+    TensorClassifier(const QStringList& to_quant, const QStringList& to_skip)
+        : _to_quant{ join(to_quant) }, _to_skip{ join(to_skip) }
+    {
+        _to_quant.optimize();
+        _to_skip.optimize();
+    }
+
+    bool operator()(const TensorHeader& header) const
+    {
+        if (header.n_dims != 2) {
+            return false;
+        }
+        const auto name = QString::fromUtf8(header.name);
+        return _to_quant.match(name).hasMatch() && !_to_skip.match(name).hasMatch();
+    }
+
+private:
+    static QRegularExpression join(const QStringList& patterns)
+    {
+        if (patterns.isEmpty()) {
+            // never matches
+            return QRegularExpression{ "(?!)" };
+        }
+        return QRegularExpression{ "(?:" + patterns.join(")|(?:") + ")" };
+    }
+
+    QRegularExpression _to_quant;
+    QRegularExpression _to_skip;
+};
+
+/// Buffers of a single tensor in flight. The slots are recycled and their buffers only grow,
+/// so once the largest tensor went through the quantizer no further allocation happens.
+/// The gain is counted in removed allocations - its effect on quantization time has not been measured.
+struct TensorSlot {
+    TensorHeader header;
+    /// Serialized (output) header
+    QByteArray header_bytes;
+    /// Tensor data as read from the input - refers into the input itself if it is in memory
+    QByteArray raw;
+    /// Tensor converted to F32
+    std::vector<float> weights;
+    /// Quantized tensor - sized exactly for the target type
+    QByteArray quants;
+    std::array<int64_t, 1 << 4> hist;
+    QFuture<void> quantized;
+    /// Set by the worker if the quantization was cancelled before it started - quants are stale then
+    bool skipped = false;
+
+    /// Convert the raw F16/F32 tensor to F32 and quantize it. Runs on the worker threads
+    void quantize(int32_t src_type, ggml_type qtype, quantizer_func quantizer, QuantizerStats *stats)
+    {
+        QTW_TRACE_SPAN(lcQuantization, "quantize tensor");
+        const auto n_elements = header.n_elements();
+        weights.resize(n_elements);
+        if (src_type == GGML_TYPE_F16) {
+            // if tensor is in float-16, convert it to float-32 row-wise
+            StageTimer timer{ stats ? &stats->convert_ns : nullptr };
+            ggml_fp16_to_fp32_row(reinterpret_cast<const ggml_fp16_t *>(raw.constData()), weights.data(), n_elements);
+        } else {
+            // else just copy it
+            std::memcpy(weights.data(), raw.constData(), n_elements * sizeof(float));
+        }
+
+        // blocks of ggml_blck_size elements, each taking ggml_type_size bytes
+        quants.resize(ggml_type_size(qtype) * n_elements / ggml_blck_size(qtype));
+        hist.fill(0);
+        StageTimer timer{ stats ? &stats->quantize_ns : nullptr };
+        const auto cur_size = quantizer(weights.data(), quants.data(), n_elements, header.dims[0], hist.data());
+        Q_ASSERT(cur_size == static_cast<size_t>(quants.size()));
+        quants.resize(cur_size);
+    }
+};
+
+/// Pull based model quantizer - the quantized model is produced tensor by tensor while it is being read,
+/// so the consumer (e.g. the whisper model loader) can start before the whole model is quantized.
+/// Tensors are read in order from the input device, quantized on \a pool with several tensors in flight
+/// and handed out in their original order. A QBuffer input (e.g. over a mapped file) is used in place -
+/// its tensors are never copied, it has to outlive the quantizer.
+class Quantizer {
+public:
+    // error codes
+    static constexpr int INVALID_MAGIC = 1;
+    static constexpr int INVALID_QUANTIZATION_TYPE = 2;
+    static constexpr int UNSUPPORTED_TENSOR_TYPE   = 3;
+    static constexpr int UNSUPPORTED_QUANT_TYPE    = 4;
+    static constexpr int CANCELLED = 5;
+    static constexpr int TRUNCATED_INPUT = 6;
+
+    Quantizer(QIODevice& in, ggml_ftype ftype, QThreadPool *pool = QThreadPool::globalInstance());
+    ~Quantizer();
+    /// Read up to \a maxSize bytes of the quantized model - returns the number of bytes read
+    qint64 read(char *data, qint64 maxSize);
+    /// Next chunk of the quantized model - empty at the end.
+    /// The chunk refers to the internal buffers and stays valid until the next call.
+    QByteArray next();
+    /// Whether the whole model was produced (or the quantization failed)
+    bool atEnd();
+    /// Error code - 0 if no error occured so far
+    int error() const;
+    /// Collect the time spent in each stage into \a stats - must outlive the quantizer
+    void setStats(QuantizerStats *stats);
+    /// Stop at the next tensor once \a cancel is cancelled - error() becomes CANCELLED.
+    /// Tensors already being quantized finish, queued ones are skipped.
+    void setCancelToken(CancelToken cancel);
+
+private:
+    /// Piece of output, optionally returning its slot to the free list once consumed
+    struct Chunk {
+        QByteArray bytes;
+        TensorSlot *release = nullptr;
+    };
+
+    void readPreamble();
+    void readTensor();
+    /// Tensor data of \a size bytes into the slot - without a copy if the input is a QBuffer.
+    /// Sets TRUNCATED_INPUT and returns false if the input ends before.
+    bool readRaw(TensorSlot *slot, qint64 size);
+    bool fill();
+    void pop();
+    TensorSlot *acquireSlot();
+
+    QIODevice& _in;
+    ggml_ftype _ftype;
+    QThreadPool *_pool;
+    ggml_type _qtype = GGML_TYPE_F32;
+    quantizer_func _quantizer = nullptr;
+    int _error = 0;
+    bool _started = false;
+    QuantizerStats *_stats = nullptr;
+    CancelToken _cancel;
+
+    const TensorClassifier _classifier{
+        // regexes of tensor names to be quantized
+        { ".*" },
+        // regexes of tensor names to not be quantized
+        {
+            // "encoder.*",
+            "encoder.conv1.bias",
+            "encoder.conv2.bias",
+            "encoder.positional_embedding",
+            "decoder.positional_embedding"
+        }
+    };
+
+    std::vector<std::unique_ptr<TensorSlot> > _slots;
+    std::vector<TensorSlot *> _free;
+    /// Tensors read but not handed out yet, in the input order
+    std::deque<TensorSlot *> _pending;
+    /// Bound on the number of tensors read ahead
+    size_t _max_in_flight;
+    /// Produced chunks of the output, _offset bytes of the front one were already read
+    std::deque<Chunk> _ready;
+    qint64 _offset = 0;
+};
+
+inline Quantizer::Quantizer(QIODevice &in, ggml_ftype ftype, QThreadPool *pool)
+    : _in{in}, _ftype{ftype}, _pool{pool}, _max_in_flight{ static_cast<size_t>(std::max(2, 2 * pool->maxThreadCount())) }
 {
-    // error codes for the function
-    constexpr int INVALID_MAGIC = 1;
-    constexpr int INVALID_QUANTIZATION_TYPE = 2;
-    constexpr int UNSUPPORTED_TENSOR_TYPE   = 3;
-    constexpr int UNSUPPORTED_QUANT_TYPE    = 4;
+    // Map the ggml float type to ggml type
+    switch (ftype) {
+    case GGML_FTYPE_MOSTLY_Q4_0: _qtype = GGML_TYPE_Q4_0;
+        break;
+    case GGML_FTYPE_MOSTLY_Q4_1: _qtype = GGML_TYPE_Q4_1;
+        break;
+    case GGML_FTYPE_MOSTLY_Q5_0: _qtype = GGML_TYPE_Q5_0;
+        break;
+    case GGML_FTYPE_MOSTLY_Q5_1: _qtype = GGML_TYPE_Q5_1;
+        break;
+    case GGML_FTYPE_MOSTLY_Q8_0: _qtype = GGML_TYPE_Q8_0;
+        break;
+    default:
+        break;
+    }
+    // Select quantizing function based on the quant type
+    _quantizer = get_quantizer(_qtype);
+
+    // ggml fills its float-16 lookup table on the first init - the conversion depends on it
+    static const bool fp16_table_ready = [](){
+        ggml_free(ggml_init({ 0, nullptr, true }));
+        return true;
+    }();
+    Q_UNUSED(fp16_table_ready);
+}
+
+inline Quantizer::~Quantizer()
+{
+    // the workers write into the slots - let them finish before the slots go away
+    for (auto slot : _pending) {
+        slot->quantized.waitForFinished();
+    }
+}
+
+inline void Quantizer::readPreamble()
+{
+    StageTimer timer{ _stats ? &_stats->read_ns : nullptr };
+    QByteArray chunk;
+    QBuffer out{ &chunk };
+    out.open(QIODeviceBase::WriteOnly);
 
     // verify magic
     {
         uint32_t magic;
-        in.read((char *) &magic, sizeof(magic));
+        _in.read((char *) &magic, sizeof(magic));
         if (magic != GGML_FILE_MAGIC) {
-            return INVALID_MAGIC;
+            _error = INVALID_MAGIC;
+            return;
         }
 
         out.write((char *) &magic, sizeof(magic));
@@ -87,10 +349,10 @@ int buffer_quantize(QIODevice& in, QIODevice& out, ggml_ftype ftype)
     // load hparams
     {
         int32_t hparams[11];
-        in.read((char *) hparams, sizeof(hparams));
+        _in.read((char *) hparams, sizeof(hparams));
 
         // Change the declared model float type to target
-        const int32_t ftype_dst = GGML_QNT_VERSION * GGML_QNT_VERSION_FACTOR + ftype;
+        const int32_t ftype_dst = GGML_QNT_VERSION * GGML_QNT_VERSION_FACTOR + _ftype;
 
         out.write((const char *) hparams, sizeof(hparams) - sizeof(int32_t));
         out.write((const char *) &ftype_dst, sizeof(ftype_dst));
@@ -100,134 +362,246 @@ int buffer_quantize(QIODevice& in, QIODevice& out, ggml_ftype ftype)
     {
         int32_t n_mel, n_fft;
 
-        in.read((char *) &n_mel, sizeof(n_mel));
-        in.read((char *) &n_fft, sizeof(n_fft));
+        _in.read((char *) &n_mel, sizeof(n_mel));
+        _in.read((char *) &n_fft, sizeof(n_fft));
 
         out.write((char *) &n_mel, sizeof(n_mel));
         out.write((char *) &n_fft, sizeof(n_fft));
 
-        write_through(in,out, n_mel * n_fft * sizeof(float));
+        write_through(_in,out, n_mel * n_fft * sizeof(float));
     }
 
     // load vocab
     {
         int32_t n_vocab = 0;
-        in.read((char *) &n_vocab, sizeof(n_vocab));
+        _in.read((char *) &n_vocab, sizeof(n_vocab));
         out.write((char *) &n_vocab, sizeof(n_vocab));
 
         for (int i = 0; i < n_vocab; i++) {
             uint32_t len;
-            in.read((char *) &len, sizeof(len));
+            _in.read((char *) &len, sizeof(len));
             out.write((char *) &len, sizeof(len));
 
-            write_through(in,out,len);
+            write_through(_in,out,len);
         }
     }
+    _ready.push_back({ std::move(chunk) });
 
-    // regexes of tensor names to not be quantized
-    const QList<QRegularExpression> to_skip = {
-        // "encoder.*",
-        QRegularExpression{ "encoder.conv1.bias"           },
-        QRegularExpression{ "encoder.conv2.bias"           },
-        QRegularExpression{ "encoder.positional_embedding" },
-        QRegularExpression{ "decoder.positional_embedding" }
-    };
+    if (_qtype == GGML_TYPE_F32) {
+        _error = INVALID_QUANTIZATION_TYPE;
+    } else if (!_quantizer) {
+        _error = UNSUPPORTED_QUANT_TYPE;
+    }
+}
 
-    // regexes of tensor names to be quantized
-    const QList<QRegularExpression> to_quant = {
-        QRegularExpression{ ".*" }
-    };
-    // quantization
+inline TensorSlot *Quantizer::acquireSlot()
+{
+    if (_free.empty()) {
+        _slots.push_back(std::make_unique<TensorSlot>());
+        return _slots.back().get();
+    }
+    auto slot = _free.back();
+    _free.pop_back();
+    return slot;
+}
+
+inline bool Quantizer::readRaw(TensorSlot *slot, qint64 size)
+{
+    if (auto buffer = qobject_cast<QBuffer *>(&_in)) {
+        // in-memory input, e.g. a mapped file or resource - the tensor is used in place
+        const auto& data = buffer->data();
+        const auto pos   = buffer->pos();
+        if (data.size() - pos < size) {
+            // a truncated model - the tensor would be read past the end of the mapping
+            _error = TRUNCATED_INPUT;
+            return false;
+        }
+        slot->raw = QByteArray::fromRawData(data.constData() + pos, size);
+        buffer->seek(pos + size);
+        return true;
+    }
+    slot->raw.resize(size);
+    if (_in.read(slot->raw.data(), slot->raw.size()) != size) {
+        _error = TRUNCATED_INPUT;
+        return false;
+    }
+    return true;
+}
+
+inline void Quantizer::readTensor()
+{
+    auto slot = acquireSlot();
+    auto& tensor_header = slot->header;
+    StageTimer timer{ _stats ? &_stats->read_ns : nullptr };
+    // read tensor header - dimentions, type, name
+    tensor_header.read(_in);
+
+    const auto n_elements = tensor_header.n_elements();
+    Q_ASSERT(n_elements < std::vector<float>{}.max_size());
+
+    // Decide wheter to quantize a tensor based on white / black lists
+    const bool quantize = _classifier(tensor_header);
+
+    if (!quantize) {
+        //If the tensor is not to be quantized - just pass it trough
+        const int bytes_per_elem = (tensor_header.ttype == 0) ? sizeof(float) : sizeof(uint16_t);
+        if (!readRaw(slot, n_elements * bytes_per_elem)) {
+            _free.push_back(slot);
+            return;
+        }
+        slot->quantized = QFuture<void>{ };
+    }
+    else
     {
-        // Map the ggml float type to ggml type
-        ggml_type qtype = GGML_TYPE_F32;
-        switch (ftype) {
-        case GGML_FTYPE_MOSTLY_Q4_0: qtype = GGML_TYPE_Q4_0;
-            break;
-        case GGML_FTYPE_MOSTLY_Q4_1: qtype = GGML_TYPE_Q4_1;
-            break;
-        case GGML_FTYPE_MOSTLY_Q5_0: qtype = GGML_TYPE_Q5_0;
+        const auto src_type = tensor_header.ttype;
+        if (src_type != GGML_TYPE_F32 && src_type != GGML_TYPE_F16) {
+            _error = UNSUPPORTED_TENSOR_TYPE;
+            _free.push_back(slot);
+            return;
+        }
+        const int bytes_per_elem = (src_type == GGML_TYPE_F16) ? sizeof(ggml_fp16_t) : sizeof(float);
+        if (!readRaw(slot, n_elements * bytes_per_elem)) {
+            _free.push_back(slot);
+            return;
+        }
+
+        // quantize on the pool
+        slot->quantized = QtConcurrent::run(_pool, [slot, src_type, qtype = _qtype, quantizer = _quantizer, stats = _stats,
+                                                     cancel = _cancel](){
+            slot->skipped = cancel.cancelled();
+            if (!slot->skipped) {
+                slot->quantize(src_type, qtype, quantizer, stats);
+            }
+        });
+
+        // set the tensor type to the target type
+        tensor_header.ttype = _qtype;
+    }
+
+    _pending.push_back(slot);
+}
+
+inline bool Quantizer::fill()
+{
+    if (!_started) {
+        _started = true;
+        readPreamble();
+    }
+    while (_ready.empty() && _error == 0) {
+        // checkpoint - the worst case latency of a cancellation is a tensor quantization
+        if (_cancel.cancelled()) {
+            _error = CANCELLED;
             break;
-        case GGML_FTYPE_MOSTLY_Q5_1: qtype = GGML_TYPE_Q5_1;
+        }
+        // keep the pool busy - read ahead up to the in-flight limit
+        while (_error == 0 && _pending.size() < _max_in_flight && _in.bytesAvailable() > 0) {
+            readTensor();
+        }
+        if (_error != 0 || _pending.empty()) {
             break;
-        case GGML_FTYPE_MOSTLY_Q8_0: qtype = GGML_TYPE_Q8_0;
+        }
+
+        // hand out tensors in the order they were read, waiting for the quantization if needed
+        auto slot = _pending.front();
+        _pending.pop_front();
+        const bool quantized = slot->quantized.isValid();
+        slot->quantized.waitForFinished();
+        if (quantized && slot->skipped) {
+            // cancelled while waiting - the tensor was never quantized and must not reach the consumer
+            _error = CANCELLED;
+            _free.push_back(slot);
             break;
-        default:
-            return INVALID_QUANTIZATION_TYPE;
         }
+        slot->header.write(slot->header_bytes);
 
+        // the chunks point into the slot - it is recycled once the data chunk is consumed
+        const auto& data = quantized ? slot->quants : slot->raw;
+        _ready.push_back({ QByteArray::fromRawData(slot->header_bytes.constData(), slot->header_bytes.size()) });
+        _ready.push_back({ QByteArray::fromRawData(data.constData(), data.size()), slot });
+    }
+    return !_ready.empty();
+}
 
-        // rest of the file is just tensors
-        TensorHeader tensor_header;
-        std::vector<float> weight_buffer;
+inline void Quantizer::pop()
+{
+    if (auto slot = _ready.front().release) {
+        _free.push_back(slot);
+    }
+    _ready.pop_front();
+    _offset = 0;
+}
 
-        while (in.bytesAvailable() > 0)
-        {
-            // read tensor header - dimentions, type, name
-            tensor_header.read(in);
-
-            auto n_elements = std::reduce(tensor_header.dims.begin(), tensor_header.dims.end(), 1, std::multiplies{ });
-            Q_ASSERT(n_elements < std::vector<float>{}.max_size());
-
-            // Decide wheter to quantize a tensor based on white / black lists
-            bool quantize = std::any_of(to_quant.begin(), to_quant.end(), [&](auto re){
-                return re.match(QString::fromUtf8(tensor_header.name)).hasMatch();
-            });
-            quantize &= std::none_of(to_skip.begin(), to_skip.end(), [&](auto re){
-                return re.match(QString::fromUtf8(tensor_header.name)).hasMatch();
-            });
-            quantize &= (tensor_header.n_dims == 2);
-
-            if (!quantize) {
-                //If the tensor is not to be quantized - just write it trough
-                // Write tensor header
-                tensor_header.write(out);
-
-                // write tensor data
-                const int bytes_per_elem = (tensor_header.ttype == 0) ? sizeof(float) : sizeof(uint16_t);
-                write_through(in,out, n_elements * bytes_per_elem);
-            }
-            else
-            {
-                if (tensor_header.ttype != GGML_TYPE_F32 && tensor_header.ttype != GGML_TYPE_F16) {
-                    return UNSUPPORTED_TENSOR_TYPE;
-                }
-
-                weight_buffer.resize(n_elements);
-                if (tensor_header.ttype == GGML_TYPE_F16) {
-                    // if tensor is in float-16, convert it to float-32
-                    std::vector<ggml_fp16_t> buff(n_elements);
-                    in.read(reinterpret_cast<char *>(buff.data()), n_elements * sizeof(ggml_fp16_t));
-                    std::transform(buff.begin(), buff.end(), weight_buffer.begin(), ggml_fp16_to_fp32);
-                } else {
-                    // else just read it normally
-                    in.read(reinterpret_cast<char *>(weight_buffer.data()), n_elements * sizeof(float));
-                }
-                // set the tensor type to the target type
-                tensor_header.ttype = qtype;
-
-                std::vector<int32_t> quants(n_elements);
-                std::vector<int64_t> hist_cur(1 << 4, 0);
-                size_t cur_size = 0;
-
-                // Select quantizing function based on the quant type
-                quantizer_func quantizer = get_quantizer(static_cast<ggml_type>(tensor_header.ttype));
-
-                if(!quantizer){
-                    return UNSUPPORTED_QUANT_TYPE;
-                }
-
-                cur_size = quantizer(weight_buffer.data(),
-                                     quants.data(), n_elements, tensor_header.dims[0], hist_cur.data());
-
-                // write quantized tensor
-                tensor_header.write(out);
-                auto n = out.write(reinterpret_cast<char *>(quants.data()), cur_size);
-            }
+inline qint64 Quantizer::read(char *data, qint64 maxSize)
+{
+    qint64 total = 0;
+    while (total < maxSize && fill()) {
+        const auto& chunk = _ready.front().bytes;
+        const auto n = std::min<qint64>(maxSize - total, chunk.size() - _offset);
+        std::memcpy(data + total, chunk.constData() + _offset, n);
+        total   += n;
+        _offset += n;
+        if (_offset == chunk.size()) {
+            pop();
         }
     }
+    return total;
+}
 
-    return 0;
-} // WhisperBackend::bufferQuantize
+inline QByteArray Quantizer::next()
+{
+    if (!fill()) {
+        return QByteArray{ };
+    }
+    auto chunk = _ready.front().bytes;
+    if (_offset > 0) {
+        chunk = chunk.sliced(_offset);
+    }
+    pop();
+    return chunk;
+}
+
+inline bool Quantizer::atEnd()
+{
+    return !fill();
+}
+
+inline int Quantizer::error() const
+{
+    return _error;
+}
+
+inline void Quantizer::setStats(QuantizerStats *stats)
+{
+    _stats = stats;
+}
+
+inline void Quantizer::setCancelToken(CancelToken cancel)
+{
+    _cancel = cancel;
+}
+
+/// Quantizes the model read from \a in and writes it to \a out.
+/// Tensors are quantized on \a pool - several tensors are in flight at once, so the conversion scales with the core count.
+/// Time spent in the individual stages is added to \a stats if given.
+/// Returns Quantizer::CANCELLED if \a cancel got cancelled - the output is incomplete then.
+/// \a progress is called with the fraction of the input consumed after every written chunk.
+inline int buffer_quantize(QIODevice& in, QIODevice& out, ggml_ftype ftype, QThreadPool *pool = QThreadPool::globalInstance(),
+                           QuantizerStats *stats = nullptr, CancelToken cancel = CancelToken{ },
+                           const std::function<void(double)>& progress = nullptr)
+{
+    Quantizer quantizer{ in, ftype, pool };
+    quantizer.setStats(stats);
+    quantizer.setCancelToken(cancel);
+    const auto total = in.size();
+    while (!quantizer.atEnd()) {
+        const auto chunk = quantizer.next();
+        StageTimer timer{ stats ? &stats->write_ns : nullptr };
+        out.write(chunk);
+        if (progress && total > 0) {
+            progress(static_cast<double>(in.pos()) / total);
+        }
+    }
+    return quantizer.error();
+} // qtw::buffer_quantize
 } // namespace qtw
 #endif // QUANTIZATION_H
@@ -0,0 +1,54 @@
+#ifndef VADKERNELS_H
+#define VADKERNELS_H
+#include <cstddef>
+
+namespace qtw {
+
+/// Width of the kernels below. Independent partial sums let the compiler keep them in vector registers
+/// without reassociating floating point math (-ffast-math is not needed).
+constexpr size_t VAD_LANES = 8;
+
+/// Sum of squares of \a n samples - \a n has to be a multiple of VAD_LANES
+inline float sum_squares(const float *x, size_t n)
+{
+    float acc[VAD_LANES] = { };
+    for (size_t i = 0; i < n; i += VAD_LANES) {
+        for (size_t j = 0; j < VAD_LANES; j++) {
+            acc[j] += x[i + j] * x[i + j];
+        }
+    }
+    float sum = 0.0f;
+    for (auto a : acc) {
+        sum += a;
+    }
+    return sum;
+}
+
+/// Number of sign changes between neighbouring samples, \a prev being the sample before x[0]
+inline int zero_crossings(const float *x, size_t n, float prev)
+{
+    int count = (prev < 0.0f) != (x[0] < 0.0f);
+    for (size_t i = 1; i < n; i++) {
+        count += (x[i - 1] < 0.0f) != (x[i] < 0.0f);
+    }
+    return count;
+}
+
+/// out[i] = x[i] * w[i]
+inline void apply_window(const float *x, const float *w, float *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i] = x[i] * w[i];
+    }
+}
+
+/// out[i] = re[i]^2 + im[i]^2
+inline void power_spectrum(const float *re, const float *im, float *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i] = re[i] * re[i] + im[i] * im[i];
+    }
+}
+
+} // namespace qtw
+#endif // VADKERNELS_H
@@ -0,0 +1,252 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+#include "AudioConverter.h"
+#include "WavDecoder.h"
+#include "WhisperBackend.h"
+#include "private/processinfo.h"
+
+/// Headless inference benchmark - loads a model through WhisperBackend and reports
+/// the real-time factor of threadedInference over a set of audio fixtures.
+
+constexpr int SAMPLE_RATE = 16000;
+constexpr double PI = 3.14159265358979323846;
+
+struct Fixture {
+    QString name;
+    std::vector<float> samples;
+};
+
+/// Decodes any WAV format WavDecoder reads (or raw 16 kHz mono float) and converts it to whisper input
+static bool readAudio(const QString& path, std::vector<float>& samples)
+{
+    QFile file{ path };
+    WavDecoder decoder{ file };
+    if (!file.open(QIODeviceBase::ReadOnly) || !decoder.open()) {
+        qWarning() << path << ":" << decoder.errorString();
+        return false;
+    }
+    AudioConverter converter{ decoder.format(), SAMPLE_RATE };
+    QByteArray chunk{ 1 << 16, Qt::Uninitialized };
+    for (qint64 n; (n = decoder.read(chunk.data(), chunk.size())) > 0;) {
+        const auto before = samples.size();
+        samples.resize(before + converter.maxOutput(n));
+        samples.resize(before + converter.convert({ chunk.constData(), static_cast<size_t>(n) },
+                                                  { samples.data() + before, samples.size() - before }));
+    }
+    return true;
+}
+
+static std::vector<Fixture> loadFixtures(const QString& directory)
+{
+    std::vector<Fixture> fixtures;
+    for (const auto& info : QDir{ directory }.entryInfoList({ "*.wav", "*.f32", "*.raw" }, QDir::Files, QDir::Size | QDir::Reversed)) {
+        Fixture fixture{ info.fileName(), { } };
+        if (!readAudio(info.filePath(), fixture.samples)) {
+            continue;
+        }
+        fixtures.push_back(std::move(fixture));
+    }
+    return fixtures;
+}
+
+/// Fixtures generated when none are given - a warbling tone over noise, so the model has something to decode
+static std::vector<Fixture> syntheticFixtures()
+{
+    std::vector<Fixture> fixtures;
+    for (int seconds : { 2, 5, 10, 30 }) {
+        Fixture fixture{ QString{ "synthetic-%1s" }.arg(seconds), std::vector<float>(seconds * SAMPLE_RATE) };
+        quint32 noise = 1;
+        for (size_t i = 0; i < fixture.samples.size(); i++) {
+            const float t = static_cast<float>(i) / SAMPLE_RATE;
+            noise = noise * 1664525u + 1013904223u;
+            fixture.samples[i] = 0.3f * std::sin(2 * PI * (220 + 80 * std::sin(2 * PI * 3 * t)) * t)
+                                 + 0.01f * (static_cast<float>(noise >> 8) / (1 << 24) - 0.5f);
+        }
+        fixtures.push_back(std::move(fixture));
+    }
+    return fixtures;
+}
+
+static ggml_ftype parseType(const QString& name)
+{
+    static const QHash<QString, ggml_ftype> types = {
+        { "f32", GGML_FTYPE_ALL_F32 },
+        { "q4_0", GGML_FTYPE_MOSTLY_Q4_0 },
+        { "q4_1", GGML_FTYPE_MOSTLY_Q4_1 },
+        { "q5_0", GGML_FTYPE_MOSTLY_Q5_0 },
+        { "q5_1", GGML_FTYPE_MOSTLY_Q5_1 },
+        { "q8_0", GGML_FTYPE_MOSTLY_Q8_0 },
+    };
+    return types.value(name.toLower(), GGML_FTYPE_UNKNOWN);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("inference_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures load time, first-result latency, real-time factor and peak memory of WhisperBackend");
+    parser.addHelpOption();
+    parser.addPositionalArgument("model", "Path to the ggml whisper model");
+    QCommandLineOption fixturesOption{ "fixtures", "Directory with .wav files of any format or raw 16 kHz mono float .f32 files (synthetic audio if omitted)", "dir" };
+    QCommandLineOption threadsOption{ "threads", "Comma separated numThreads values to sweep", "list", "1,2,4" };
+    QCommandLineOption typesOption{ "types", "Comma separated quantization types to sweep (f32,q4_0,q4_1,q5_0,q5_1,q8_0)", "list", "f32,q4_0,q5_1,q8_0" };
+    QCommandLineOption repeatOption{ "repeat", "Runs per fixture", "n", "3" };
+    QCommandLineOption workersOption{ "workers", "Inference workers - the runs of a fixture are submitted at once", "n", "1" };
+    QCommandLineOption formatOption{ "format", "Output format: csv or json", "format", "csv" };
+    QCommandLineOption outputOption{ "output", "Write the report to a file instead of stdout", "file" };
+    parser.addOptions({ fixturesOption, threadsOption, typesOption, repeatOption, workersOption, formatOption, outputOption });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+    const auto modelPath = parser.positionalArguments().constFirst();
+    const auto fixtures  = parser.isSet(fixturesOption) ? loadFixtures(parser.value(fixturesOption)) : syntheticFixtures();
+    const int repeat     = std::max(1, parser.value(repeatOption).toInt());
+    const int workers    = std::max(1, parser.value(workersOption).toInt());
+    if (fixtures.empty()) {
+        qCritical() << "No usable fixtures found";
+        return 1;
+    }
+
+    qRegisterMetaType<AudioBuffer>("AudioBuffer");
+    QJsonArray report;
+
+    const auto types = parser.value(typesOption).split(',', Qt::SkipEmptyParts);
+    for (const auto& typeName : types) {
+        const auto ftype = parseType(typeName);
+        if (ftype == GGML_FTYPE_UNKNOWN) {
+            qWarning() << "Unknown quantization type" << typeName;
+            continue;
+        }
+
+        if (types.size() > 1) {
+            // the peak RSS is a process-wide high-water mark - every type gets a fresh process so its rows
+            // do not include the models measured before it
+            QStringList arguments{ modelPath, "--types", typeName, "--format", "json",
+                                   "--threads", parser.value(threadsOption), "--repeat", QString::number(repeat),
+                                   "--workers", QString::number(workers) };
+            if (parser.isSet(fixturesOption)) {
+                arguments << "--fixtures" << parser.value(fixturesOption);
+            }
+            QProcess child;
+            child.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+            child.start(QCoreApplication::applicationFilePath(), arguments);
+            if (!child.waitForFinished(-1) || child.exitStatus() != QProcess::NormalExit || child.exitCode() != 0) {
+                qCritical() << typeName << ": benchmark process failed";
+                continue;
+            }
+            for (const auto& row : QJsonDocument::fromJson(child.readAllStandardOutput()).array()) {
+                report.append(row);
+            }
+            continue;
+        }
+
+        // load without the cache - the measured load time includes the quantization
+        WhisperBackend backend{ modelPath };
+        backend.setNumWorkers(workers);
+        bool failed = false;
+        QObject::connect(&backend, &WhisperBackend::error, [&](const QString& s){
+            qCritical() << typeName << ":" << s;
+            failed = true;
+        });
+        backend.loadModel(ftype);
+        if (failed) {
+            continue;
+        }
+        const auto loadMs = backend.info()->getLoadTimeMs();
+        bool first = true;
+
+        for (const auto& threads : parser.value(threadsOption).split(',', Qt::SkipEmptyParts)) {
+            backend.setNumThreads(threads.toInt());
+
+            for (const auto& fixture : fixtures) {
+                auto samples = AudioPool::shared().acquire();
+                samples.append(fixture.samples);
+
+                // all runs are queued at once - with several workers the wall time measures throughput
+                QElapsedTimer timer;
+                QEventLoop loop;
+                qint64 first_ms = -1;
+                int remaining   = repeat;
+                auto connection = QObject::connect(&backend, &WhisperBackend::resultReady, [&](){
+                    if (first) {
+                        // the very first inference after load runs with cold caches
+                        first_ms = timer.elapsed();
+                        first    = false;
+                    }
+                    if (--remaining == 0) {
+                        loop.quit();
+                    }
+                });
+                timer.start();
+                for (int i = 0; i < repeat; i++) {
+                    backend.threadedInference(samples);
+                }
+                loop.exec();
+                const auto total_ns = timer.nsecsElapsed();
+                QObject::disconnect(connection);
+
+                const double audio_s = static_cast<double>(fixture.samples.size()) / SAMPLE_RATE;
+                const double infer_s = total_ns / 1e9 / repeat;
+                report.append(QJsonObject{
+                    { "model", QFileInfo{ modelPath }.fileName() },
+                    { "type", typeName },
+                    { "threads", threads.toInt() },
+                    { "workers", workers },
+                    { "fixture", fixture.name },
+                    { "audio_s", audio_s },
+                    { "load_ms", loadMs },
+                    { "first_result_ms", first_ms },
+                    { "inference_ms", infer_s * 1000 },
+                    { "rtf", infer_s / audio_s },
+                    { "peak_rss_mb", qtw::peak_rss_bytes() / double(1 << 20) },
+                });
+                qInfo().noquote() << typeName << "threads:" << threads << fixture.name << "RTF:" << infer_s / audio_s;
+            }
+        }
+    }
+
+    QFile outputFile;
+    QTextStream out{ stdout };
+    if (parser.isSet(outputOption)) {
+        outputFile.setFileName(parser.value(outputOption));
+        if (!outputFile.open(QIODeviceBase::WriteOnly | QIODeviceBase::Text)) {
+            qCritical() << "Cannot write" << outputFile.fileName();
+            return 1;
+        }
+        out.setDevice(&outputFile);
+    }
+
+    if (parser.value(formatOption) == "json") {
+        out << QJsonDocument{ report }.toJson();
+    } else {
+        const QStringList columns = { "model", "type", "threads", "workers", "fixture", "audio_s", "load_ms",
+                                      "first_result_ms", "inference_ms", "rtf", "peak_rss_mb" };
+        out << columns.join(',') << '\n';
+        for (const auto& row : report) {
+            QStringList values;
+            for (const auto& column : columns) {
+                values << row.toObject().value(column).toVariant().toString();
+            }
+            out << values.join(',') << '\n';
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <QTest>
+#include <QBuffer>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include "private/quantization.h"
+#include "synthetic_model.h"
+#include "ggml.h"
+
+/// Quantization throughput on a synthetic, tiny-sized model - runs offline
+/// To compare two revisions, build quantizer_bench on each and run it with the same -iterations on an idle host.
+/// The ms per type and the per-stage split are what changes to the quantizer are judged by.
+class QuantizerBench : public QObject
+{
+    Q_OBJECT
+    ggml_context* _ctx = nullptr;
+    QTemporaryDir _dir;
+    QByteArray _model;
+    QString _modelPath;
+
+private slots:
+
+    void initTestCase()
+    {
+        // initializes float-16 lookup table - critical to quantization
+        _ctx = ggml_init({});
+        QVERIFY(_ctx);
+
+        QBuffer model{ &_model };
+        model.open(QIODeviceBase::WriteOnly);
+        qtw_test::write_synthetic_model(model);
+
+        QVERIFY(_dir.isValid());
+        _modelPath = _dir.filePath("ggml-synthetic.bin");
+        QFile file{ _modelPath };
+        QVERIFY(file.open(QIODeviceBase::WriteOnly));
+        QCOMPARE(file.write(_model), qint64{ _model.size() });
+    }
+
+    void cleanupTestCase()
+    {
+        ggml_free(_ctx);
+    }
+
+    void quantize_data()
+    {
+        QTest::addColumn<int>("ftype");
+        QTest::addColumn<bool>("fromFile");
+
+        const std::pair<const char *, ggml_ftype> types[] = {
+            { "q4_0", GGML_FTYPE_MOSTLY_Q4_0 },
+            { "q4_1", GGML_FTYPE_MOSTLY_Q4_1 },
+            { "q5_0", GGML_FTYPE_MOSTLY_Q5_0 },
+            { "q5_1", GGML_FTYPE_MOSTLY_Q5_1 },
+            { "q8_0", GGML_FTYPE_MOSTLY_Q8_0 },
+        };
+        for (const auto& [name, type] : types) {
+            QTest::addRow("%s/buffer", name) << int{ type } << false;
+            QTest::addRow("%s/file", name) << int{ type } << true;
+        }
+    }
+
+    void quantize()
+    {
+        QFETCH(int, ftype);
+        QFETCH(bool, fromFile);
+
+        qtw::QuantizerStats stats;
+        QElapsedTimer timer;
+        qint64 elapsed  = 0;
+        int iterations  = 0;
+
+        QBENCHMARK {
+            QBuffer buffer{ &_model };
+            QFile file{ _modelPath };
+            QIODevice& source = fromFile ? static_cast<QIODevice&>(file) : buffer;
+            QVERIFY(source.open(QIODeviceBase::ReadOnly));
+            QBuffer result;
+            result.open(QIODeviceBase::WriteOnly);
+
+            timer.start();
+            QCOMPARE(qtw::buffer_quantize(source, result, static_cast<ggml_ftype>(ftype), QThreadPool::globalInstance(), &stats), 0);
+            elapsed += timer.nsecsElapsed();
+            iterations++;
+        }
+
+        auto per_run_ms = [&](qint64 ns){
+            return ns / 1e6 / iterations;
+        };
+        const double seconds = elapsed / 1e9 / iterations;
+        qInfo().nospace() << QTest::currentDataTag() << ": "
+                          << per_run_ms(elapsed) << " ms, "
+                          << _model.size() / 1e6 / seconds << " MB/s"
+                          << " | read " << per_run_ms(stats.read_ns) << " ms"
+                          << ", F16->F32 " << per_run_ms(stats.convert_ns) << " ms"
+                          << ", quantize " << per_run_ms(stats.quantize_ns) << " ms"
+                          << ", write " << per_run_ms(stats.write_ns) << " ms"
+                          << " (conversion and quantization summed over " << QThreadPool::globalInstance()->maxThreadCount() << " threads)";
+    }
+};
+
+QTEST_MAIN(QuantizerBench)
+#include "bench_quant.moc"
@@ -0,0 +1,110 @@
+#ifndef SYNTHETIC_MODEL_H
+#define SYNTHETIC_MODEL_H
+#include <QIODevice>
+#include <QRandomGenerator>
+#include <ggml.h>
+
+namespace qtw_test {
+
+/// Shape of a generated model - defaults follow the tiny whisper model
+struct SyntheticModelParams {
+    int32_t n_vocab  = 51864;
+    int32_t n_ctx    = 1500;
+    int32_t n_state  = 384;
+    int32_t n_head   = 6;
+    int32_t n_layer  = 4;
+    int32_t n_mels   = 80;
+    quint32 seed     = 1234;
+};
+
+/// Writes a whisper ggml model with random F16 weights to \a out.
+/// The layout matches a real model closely enough for the quantizer, which only looks at tensor names and shapes.
+inline void write_synthetic_model(QIODevice& out, const SyntheticModelParams& p = SyntheticModelParams{ })
+{
+    QRandomGenerator rng{ p.seed };
+    auto write_i32 = [&](int32_t v){
+        out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+    };
+
+    write_i32(GGML_FILE_MAGIC);
+    // hparams
+    for (auto v : { p.n_vocab, p.n_ctx, p.n_state, p.n_head, p.n_layer, 448, p.n_state, p.n_head, p.n_layer, p.n_mels,
+                    int32_t{ GGML_FTYPE_MOSTLY_F16 } }) {
+        write_i32(v);
+    }
+
+    // mel filters
+    const int32_t n_fft = 201;
+    write_i32(p.n_mels);
+    write_i32(n_fft);
+    for (int i = 0; i < p.n_mels * n_fft; i++) {
+        const float f = static_cast<float>(rng.generateDouble());
+        out.write(reinterpret_cast<const char *>(&f), sizeof(f));
+    }
+
+    // vocab
+    write_i32(p.n_vocab);
+    for (int i = 0; i < p.n_vocab; i++) {
+        const auto token = QByteArray::number(i);
+        write_i32(token.size());
+        out.write(token);
+    }
+
+    auto tensor = [&](const QByteArray& name, std::initializer_list<int32_t> dims){
+        // 1D tensors are stored as F32, the rest as F16
+        const int32_t ttype = dims.size() == 1 ? GGML_TYPE_F32 : GGML_TYPE_F16;
+        write_i32(static_cast<int32_t>(dims.size()));
+        write_i32(name.size());
+        write_i32(ttype);
+        int64_t n_elements = 1;
+        for (auto d : dims) {
+            write_i32(d);
+            n_elements *= d;
+        }
+        out.write(name);
+
+        QByteArray data{ static_cast<qsizetype>(n_elements * (ttype == GGML_TYPE_F32 ? sizeof(float) : sizeof(ggml_fp16_t))),
+                         Qt::Uninitialized };
+        for (int64_t i = 0; i < n_elements; i++) {
+            const float f = static_cast<float>(rng.generateDouble() * 0.2 - 0.1);
+            if (ttype == GGML_TYPE_F32) {
+                reinterpret_cast<float *>(data.data())[i] = f;
+            } else {
+                reinterpret_cast<ggml_fp16_t *>(data.data())[i] = ggml_fp32_to_fp16(f);
+            }
+        }
+        out.write(data);
+    };
+
+    const int32_t s = p.n_state;
+    tensor("encoder.positional_embedding", { s, p.n_ctx });
+    tensor("encoder.conv1.weight", { 3, p.n_mels, s });
+    tensor("encoder.conv1.bias", { 1, s });
+    tensor("encoder.conv2.weight", { 3, s, s });
+    tensor("encoder.conv2.bias", { 1, s });
+    for (auto prefix : { QByteArray{ "encoder.blocks." }, QByteArray{ "decoder.blocks." } }) {
+        for (int l = 0; l < p.n_layer; l++) {
+            const auto block = prefix + QByteArray::number(l);
+            const auto attns = prefix.startsWith("encoder") ? QList<QByteArray>{ ".attn" }
+                                                            : QList<QByteArray>{ ".attn", ".cross_attn" };
+            for (const auto& attn : attns) {
+                tensor(block + attn + ".query.weight", { s, s });
+                tensor(block + attn + ".query.bias", { s });
+                tensor(block + attn + ".key.weight", { s, s });
+                tensor(block + attn + ".value.weight", { s, s });
+                tensor(block + attn + ".value.bias", { s });
+                tensor(block + attn + ".out.weight", { s, s });
+                tensor(block + attn + ".out.bias", { s });
+            }
+            tensor(block + ".mlp.0.weight", { s, 4 * s });
+            tensor(block + ".mlp.0.bias", { 4 * s });
+            tensor(block + ".mlp.2.weight", { 4 * s, s });
+            tensor(block + ".mlp.2.bias", { s });
+        }
+    }
+    tensor("decoder.positional_embedding", { s, 448 });
+    tensor("decoder.token_embedding.weight", { s, p.n_vocab });
+}
+
+} // namespace qtw_test
+#endif // SYNTHETIC_MODEL_H
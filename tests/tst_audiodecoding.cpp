@@ -0,0 +1,182 @@
+#include <QTest>
+#include <QBuffer>
+#include <QtEndian>
+#include <cmath>
+#include <numbers>
+#include "AudioConverter.h"
+#include "WavDecoder.h"
+
+namespace {
+/// Interleaved 16-bit samples of a tone at \a frequency
+QByteArray make_tone(int rate, int channels, int frames, double frequency)
+{
+    QByteArray pcm;
+    for (int i = 0; i < frames; i++) {
+        const auto v = static_cast<qint16>(16000 * std::sin(2 * std::numbers::pi * frequency * i / rate));
+        for (int c = 0; c < channels; c++) {
+            pcm.append(reinterpret_cast<const char *>(&v), sizeof(v));
+        }
+    }
+    return pcm;
+}
+
+/// RMS of the converted samples, skipping the filter warm up at both ends
+double rms(const std::vector<float>& samples)
+{
+    double sum = 0;
+    for (size_t i = 1000; i < samples.size() - 1000; i++) {
+        sum += samples[i] * samples[i];
+    }
+    return std::sqrt(sum / (samples.size() - 2000));
+}
+
+/// 16-bit PCM WAV with a 1 kHz tone of the given length
+QByteArray make_wav(int rate, int channels, int frames)
+{
+    const auto pcm = make_tone(rate, channels, frames, 1000);
+
+    QByteArray wav;
+    auto u32 = [&](quint32 v){
+        v = qToLittleEndian(v);
+        wav.append(reinterpret_cast<const char *>(&v), 4);
+    };
+    auto u16 = [&](quint16 v){
+        v = qToLittleEndian(v);
+        wav.append(reinterpret_cast<const char *>(&v), 2);
+    };
+    wav.append("RIFF");
+    u32(36 + 12 + pcm.size());
+    wav.append("WAVE");
+    // unknown chunks have to be skipped
+    wav.append("LIST");
+    u32(4);
+    wav.append("INFO");
+    wav.append("fmt ");
+    u32(16);
+    u16(1);
+    u16(channels);
+    u32(rate);
+    u32(rate * channels * 2);
+    u16(channels * 2);
+    u16(16);
+    wav.append("data");
+    u32(pcm.size());
+    return wav + pcm;
+}
+} // namespace
+
+class AudioDecodingTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void header()
+    {
+        auto wav = make_wav(44100, 2, 4410);
+        QBuffer buffer{ &wav };
+        buffer.open(QIODeviceBase::ReadOnly);
+
+        WavDecoder decoder{ buffer };
+        QVERIFY(decoder.open());
+        QCOMPARE(decoder.format().sampleRate(), 44100);
+        QCOMPARE(decoder.format().channelCount(), 2);
+        QCOMPARE(decoder.format().sampleFormat(), QAudioFormat::Int16);
+        QCOMPARE(decoder.dataSize(), qint64{ 4410 * 4 });
+
+        // odd sizes are rounded down to whole frames
+        char chunk[1001];
+        qint64 total = 0;
+        qint64 n     = 0;
+        while ((n = decoder.read(chunk, sizeof(chunk))) >= 0) {
+            QCOMPARE(n % 4, 0);
+            total += n;
+        }
+        QCOMPARE(total, decoder.dataSize());
+        QVERIFY(decoder.atEnd());
+    }
+
+    void rawInput()
+    {
+        QByteArray raw(1600 * sizeof(float), '\0');
+        QBuffer buffer{ &raw };
+        buffer.open(QIODeviceBase::ReadOnly);
+
+        WavDecoder decoder{ buffer };
+        QVERIFY(decoder.open());
+        QCOMPARE(decoder.format().sampleFormat(), QAudioFormat::Float);
+        QCOMPARE(decoder.format().sampleRate(), 16000);
+        QCOMPARE(decoder.dataSize(), qint64{ raw.size() });
+    }
+
+    void chunkedConversion()
+    {
+        const int frames = 44100;
+        auto wav = make_wav(44100, 2, frames);
+        QBuffer buffer{ &wav };
+        buffer.open(QIODeviceBase::ReadOnly);
+        WavDecoder decoder{ buffer };
+        QVERIFY(decoder.open());
+        const auto pcm = wav.right(decoder.dataSize());
+
+        AudioConverter whole{ decoder.format() };
+        std::vector<float> expected(whole.maxOutput(pcm.size()));
+        expected.resize(whole.convert({ pcm.constData(), static_cast<size_t>(pcm.size()) }, expected));
+        // one second of input gives one second at 16 kHz
+        QVERIFY(std::abs(static_cast<int>(expected.size()) - 16000) <= 1);
+
+        // chunks splitting frames produce the same samples
+        AudioConverter chunked{ decoder.format() };
+        std::vector<float> actual;
+        for (qsizetype offset = 0; offset < pcm.size(); offset += 999) {
+            const auto chunk = pcm.mid(offset, 999);
+            std::vector<float> out(chunked.maxOutput(chunk.size()));
+            out.resize(chunked.convert({ chunk.constData(), static_cast<size_t>(chunk.size()) }, out));
+            actual.insert(actual.end(), out.begin(), out.end());
+        }
+        QCOMPARE(actual.size(), expected.size());
+        for (size_t i = 0; i < actual.size(); i++) {
+            QVERIFY(std::abs(actual[i] - expected[i]) < 1e-6f);
+        }
+    }
+
+    void resampling_data()
+    {
+        QTest::addColumn<int>("rate");
+        QTest::newRow("44.1 kHz") << 44100;
+        QTest::newRow("48 kHz") << 48000;
+        QTest::newRow("8 kHz") << 8000;
+        QTest::newRow("16 kHz") << 16000;
+    }
+
+    void resampling()
+    {
+        QFETCH(int, rate);
+        QAudioFormat format;
+        format.setSampleFormat(QAudioFormat::Int16);
+        format.setSampleRate(rate);
+        format.setChannelCount(2);
+
+        auto convert = [&](double frequency){
+            const auto pcm = make_tone(rate, 2, rate, frequency);
+            AudioConverter converter{ format };
+            std::vector<float> out(converter.maxOutput(pcm.size()));
+            out.resize(converter.convert({ pcm.constData(), static_cast<size_t>(pcm.size()) }, out));
+            return out;
+        };
+
+        // speech band passes unchanged - a full scale sine has an RMS of 1/sqrt(2)
+        const auto tone = convert(1000);
+        QCOMPARE(static_cast<int>(tone.size()), 16000);
+        QVERIFY(std::abs(rms(tone) - 16000.0 / 32768 / std::numbers::sqrt2) < 1e-3);
+
+        if (rate > 16000) {
+            // above the output Nyquist frequency - filtered instead of aliased
+            const auto alias = convert(12000);
+            QVERIFY(20 * std::log10(rms(alias) / rms(tone)) < -60);
+        }
+    }
+};
+
+QTEST_MAIN(AudioDecodingTest)
+#include "tst_audiodecoding.moc"
@@ -0,0 +1,62 @@
+#include <QTest>
+#include "AudioPool.h"
+
+class AudioPoolTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void reuse()
+    {
+        AudioPool pool{ 1024, 1 };
+        QCOMPARE(pool.freeBlocks(), size_t(1));
+
+        auto buffer = pool.acquire();
+        auto *data = buffer.data();
+        QCOMPARE(pool.freeBlocks(), size_t(0));
+
+        buffer.grow(512);
+        buffer = AudioBuffer{ };
+        QCOMPARE(pool.freeBlocks(), size_t(1));
+
+        // the released block comes back empty and without reallocation
+        auto again = pool.acquire();
+        QCOMPARE(again.size(), size_t(0));
+        again.grow(1024);
+        QCOMPARE(again.data(), data);
+    }
+
+    void sharing()
+    {
+        AudioPool pool{ 16 };
+        auto buffer = pool.acquire();
+        const float samples[] = { 1.0f, 2.0f, 3.0f };
+        buffer.append(samples);
+
+        auto copy = buffer;
+        QCOMPARE(copy.data(), buffer.data());
+        QCOMPARE(copy.size(), size_t(3));
+
+        buffer = AudioBuffer{ };
+        QCOMPARE(pool.freeBlocks(), size_t(0));
+        QCOMPARE(copy.samples()[2], 3.0f);
+
+        copy = AudioBuffer{ };
+        QCOMPARE(pool.freeBlocks(), size_t(1));
+    }
+
+    void outlivesPool()
+    {
+        AudioBuffer buffer;
+        {
+            AudioPool pool{ 16 };
+            buffer = pool.acquire();
+        }
+        buffer.grow(32);
+        QCOMPARE(buffer.size(), size_t(32));
+    }
+};
+
+QTEST_MAIN(AudioPoolTest)
+#include "tst_audiopool.moc"
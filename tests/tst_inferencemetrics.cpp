@@ -0,0 +1,106 @@
+#include <QTest>
+#include <QSignalSpy>
+#include "InferenceMetrics.h"
+
+namespace {
+constexpr qint64 MS = 1000000;
+
+InferenceTiming timing(qint64 audio_ms, qint64 processing_ms, int tokens = 0)
+{
+    InferenceTiming t;
+    t.audio_ns  = audio_ms * MS;
+    t.queue_ns  = 5 * MS;
+    t.mel_ns    = processing_ms * MS / 10;
+    t.encode_ns = processing_ms * MS / 2;
+    t.decode_ns = processing_ms * MS - t.mel_ns - t.encode_ns;
+    t.tokens    = tokens;
+    return t;
+}
+} // namespace
+
+class InferenceMetricsTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void percentile()
+    {
+        QCOMPARE(InferenceMetrics::percentile({ }, 50), 0.0);
+        QCOMPARE(InferenceMetrics::percentile({ 3 }, 99), 3.0);
+
+        std::vector<double> values(100);
+        for (size_t i = 0; i < values.size(); i++) {
+            // shuffled order - the percentile must not depend on it
+            values[(i * 37) % values.size()] = static_cast<double>(i + 1);
+        }
+        QCOMPARE(InferenceMetrics::percentile(values, 50), 50.0);
+        QCOMPARE(InferenceMetrics::percentile(values, 95), 95.0);
+        QCOMPARE(InferenceMetrics::percentile(values, 99), 99.0);
+        QCOMPARE(InferenceMetrics::percentile(values, 100), 100.0);
+    }
+
+    void record()
+    {
+        InferenceMetrics metrics;
+        QSignalSpy updated{ &metrics, &InferenceMetrics::updated };
+
+        metrics.record(timing(2000, 1000, 20));
+        QCOMPARE(updated.count(), 1);
+        QCOMPARE(metrics.getUtterances(), 1);
+        QCOMPARE(metrics.getAudioMs(), 2000.0);
+        QCOMPARE(metrics.getQueueWaitMs(), 5.0);
+        QCOMPARE(metrics.getMelMs() + metrics.getEncodeMs() + metrics.getDecodeMs(), 1000.0);
+        QCOMPARE(metrics.getRealTimeFactor(), 0.5);
+        QCOMPARE(metrics.getTokensPerSecond(), 20 / 0.4);
+        QCOMPARE(metrics.getLatencyP50Ms(), 1005.0);
+
+        metrics.reset();
+        QCOMPARE(metrics.getUtterances(), 0);
+        QCOMPARE(metrics.getRtfP99(), 0.0);
+    }
+
+    void incompleteTimings()
+    {
+        InferenceMetrics metrics;
+        QSignalSpy updated{ &metrics, &InferenceMetrics::updated };
+        metrics.record(timing(1000, 500));
+
+        // aborted decode - the timeline stopped before the decoder ran
+        auto aborted = timing(1000, 500);
+        aborted.decode_ns = 0;
+        metrics.record(aborted);
+        // nothing decoded at all
+        metrics.record(timing(0, 500));
+        metrics.record(InferenceTiming{ });
+
+        QCOMPARE(updated.count(), 1);
+        QCOMPARE(metrics.getUtterances(), 1);
+        QCOMPARE(metrics.getRealTimeFactor(), 0.5);
+        QCOMPARE(metrics.getRtfP50(), 0.5);
+    }
+
+    void rollingWindow()
+    {
+        InferenceMetrics metrics;
+        // one slow utterance among fast ones only shows in the tail
+        for (int i = 0; i < 99; i++) {
+            metrics.record(timing(1000, 100));
+        }
+        metrics.record(timing(1000, 3000));
+        QCOMPARE(metrics.getRtfP50(), 0.1);
+        QCOMPARE(metrics.getRtfP95(), 0.1);
+        QCOMPARE(metrics.getRtfP99(), 0.1);
+        metrics.record(timing(1000, 3000));
+        QCOMPARE(metrics.getRtfP99(), 3.0);
+
+        // the slow ones drop out of the window eventually
+        for (size_t i = 0; i < InferenceMetrics::WINDOW; i++) {
+            metrics.record(timing(1000, 100));
+        }
+        QCOMPARE(metrics.getRtfP99(), 0.1);
+    }
+};
+
+QTEST_MAIN(InferenceMetricsTest)
+#include "tst_inferencemetrics.moc"
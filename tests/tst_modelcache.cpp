@@ -0,0 +1,143 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include "ModelCache.h"
+
+namespace {
+void write_file(const QString& path, const QByteArray& content)
+{
+    QFile file{ path };
+    QVERIFY(file.open(QIODeviceBase::WriteOnly));
+    file.write(content);
+}
+
+void set_modified(const QString& path, const QDateTime& time)
+{
+    QFile file{ path };
+    QVERIFY(file.open(QIODeviceBase::ReadWrite));
+    QVERIFY(file.setFileTime(time, QFileDevice::FileModificationTime));
+}
+} // namespace
+
+class ModelCacheTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void disabled()
+    {
+        QTemporaryDir dir;
+        const auto source = dir.filePath("model.bin");
+        write_file(source, "weights");
+
+        ModelCache cache;
+        QVERIFY(!cache.isEnabled());
+        QVERIFY(cache.store(source, GGML_FTYPE_MOSTLY_Q5_1, "quantized").isEmpty());
+        QVERIFY(cache.lookup(source, GGML_FTYPE_MOSTLY_Q5_1).isEmpty());
+        QVERIFY(!ModelCache{ dir.filePath("cache"), 0 }.isEnabled());
+    }
+
+    void hit()
+    {
+        QTemporaryDir dir;
+        const auto source = dir.filePath("model.bin");
+        write_file(source, QByteArray(4096, 'w'));
+        ModelCache cache{ dir.filePath("cache") };
+
+        QVERIFY(cache.lookup(source, GGML_FTYPE_MOSTLY_Q5_1).isEmpty());
+        const auto stored = cache.store(source, GGML_FTYPE_MOSTLY_Q5_1, "quantized");
+        QVERIFY(!stored.isEmpty());
+        QCOMPARE(cache.lookup(source, GGML_FTYPE_MOSTLY_Q5_1), stored);
+
+        QFile entry{ stored };
+        QVERIFY(entry.open(QIODeviceBase::ReadOnly));
+        QCOMPARE(entry.readAll(), QByteArray{ "quantized" });
+    }
+
+    void miss()
+    {
+        QTemporaryDir dir;
+        const auto source = dir.filePath("model.bin");
+        write_file(source, QByteArray(4096, 'w'));
+        ModelCache cache{ dir.filePath("cache") };
+        QVERIFY(!cache.store(source, GGML_FTYPE_MOSTLY_Q5_1, "quantized").isEmpty());
+
+        // another target type
+        QVERIFY(cache.lookup(source, GGML_FTYPE_MOSTLY_Q8_0).isEmpty());
+
+        // same size and modification time, other content - only the fingerprint tells them apart
+        const auto modified = QFileInfo{ source }.lastModified();
+        write_file(source, QByteArray(4096, 'x'));
+        set_modified(source, modified);
+        QCOMPARE(QFileInfo{ source }.lastModified(), modified);
+        QVERIFY(cache.lookup(source, GGML_FTYPE_MOSTLY_Q5_1).isEmpty());
+
+        // same content, touched - treated as another model as well
+        write_file(source, QByteArray(4096, 'w'));
+        set_modified(source, modified.addSecs(60));
+        QVERIFY(cache.lookup(source, GGML_FTYPE_MOSTLY_Q5_1).isEmpty());
+    }
+
+    void eviction()
+    {
+        QTemporaryDir dir;
+        QStringList sources;
+        for (const auto name : { "a.bin", "b.bin", "c.bin" }) {
+            sources.append(dir.filePath(name));
+            write_file(sources.back(), name);
+        }
+        const QByteArray model(100, 'q');
+        ModelCache cache{ dir.filePath("cache"), 250 };
+
+        const auto a = cache.store(sources[0], GGML_FTYPE_MOSTLY_Q5_1, model);
+        const auto b = cache.store(sources[1], GGML_FTYPE_MOSTLY_Q5_1, model);
+        QVERIFY(!a.isEmpty() && !b.isEmpty());
+        // b is more recent than a - until a is looked up
+        const auto now = QDateTime::currentDateTime();
+        set_modified(a, now.addSecs(-7200));
+        set_modified(b, now.addSecs(-3600));
+        QCOMPARE(cache.lookup(sources[0], GGML_FTYPE_MOSTLY_Q5_1), a);
+
+        // no room for a third entry - the least recently used one goes
+        const auto c = cache.store(sources[2], GGML_FTYPE_MOSTLY_Q5_1, model);
+        QVERIFY(!c.isEmpty());
+        QVERIFY(cache.lookup(sources[1], GGML_FTYPE_MOSTLY_Q5_1).isEmpty());
+        QCOMPARE(cache.lookup(sources[0], GGML_FTYPE_MOSTLY_Q5_1), a);
+        QCOMPARE(cache.lookup(sources[2], GGML_FTYPE_MOSTLY_Q5_1), c);
+
+        // larger than the whole cache - not stored, nothing evicted for it
+        QVERIFY(cache.store(sources[1], GGML_FTYPE_MOSTLY_Q5_1, QByteArray(300, 'q')).isEmpty());
+        QVERIFY(QFileInfo::exists(a) && QFileInfo::exists(c));
+    }
+
+    void streamedEntry()
+    {
+        QTemporaryDir dir;
+        const auto source = dir.filePath("model.bin");
+        // the source is larger than the cache - only the quantized entry has to fit
+        write_file(source, QByteArray(4096, 'w'));
+        ModelCache cache{ dir.filePath("cache"), 250 };
+
+        auto writer = cache.storeWriter(source, GGML_FTYPE_MOSTLY_Q5_1);
+        QVERIFY(writer);
+        writer->write(QByteArray(200, 'q'));
+        const auto stored = cache.commit(*writer);
+        QVERIFY(!stored.isEmpty());
+        QCOMPARE(cache.lookup(source, GGML_FTYPE_MOSTLY_Q5_1), stored);
+
+        // an entry outgrowing the limit while it is written is dropped on commit
+        writer = cache.storeWriter(source, GGML_FTYPE_MOSTLY_Q8_0);
+        QVERIFY(writer);
+        writer->write(QByteArray(300, 'q'));
+        QVERIFY(cache.commit(*writer).isEmpty());
+        QVERIFY(cache.lookup(source, GGML_FTYPE_MOSTLY_Q8_0).isEmpty());
+        QCOMPARE(cache.lookup(source, GGML_FTYPE_MOSTLY_Q5_1), stored);
+    }
+};
+
+QTEST_MAIN(ModelCacheTest)
+#include "tst_modelcache.moc"
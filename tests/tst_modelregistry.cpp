@@ -0,0 +1,113 @@
+#include <QTest>
+#include <QThread>
+#include <thread>
+#include "ModelRegistry.h"
+
+namespace {
+/// Registry tests never touch real contexts - models are fake pointers freed into a list
+whisper_context *fake_context(quintptr id)
+{
+    return reinterpret_cast<whisper_context *>(id);
+}
+} // namespace
+
+class ModelRegistryTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void sharing()
+    {
+        std::vector<whisper_context *> freed;
+        ModelRegistry registry{ 1000, [&](whisper_context *ctx){ freed.push_back(ctx); } };
+        int loads   = 0;
+        auto loader = [&](qint64& size){
+            size = 100;
+            return fake_context(++loads);
+        };
+
+        auto a = registry.acquire("model.bin", GGML_FTYPE_MOSTLY_Q5_1, loader);
+        auto b = registry.acquire("model.bin", GGML_FTYPE_MOSTLY_Q5_1, loader);
+        QCOMPARE(a.get(), b.get());
+        QCOMPARE(loads, 1);
+        QCOMPARE(registry.hits(), qint64{ 1 });
+        QCOMPARE(registry.misses(), qint64{ 1 });
+
+        // another float type is another model
+        auto c = registry.acquire("model.bin", GGML_FTYPE_MOSTLY_Q8_0, loader);
+        QVERIFY(c.get() != a.get());
+        QCOMPARE(registry.residentBytes(), qint64{ 200 });
+
+        // released models stay warm
+        a.reset();
+        b.reset();
+        auto again = registry.acquire("model.bin", GGML_FTYPE_MOSTLY_Q5_1, loader);
+        QCOMPARE(loads, 2);
+        QVERIFY(freed.empty());
+    }
+
+    void eviction()
+    {
+        std::vector<whisper_context *> freed;
+        ModelRegistry registry{ 250, [&](whisper_context *ctx){ freed.push_back(ctx); } };
+        quintptr id = 0;
+        auto loader = [&](qint64& size){
+            size = 100;
+            return fake_context(++id);
+        };
+
+        auto first  = registry.acquire("first.bin", GGML_FTYPE_ALL_F32, loader);
+        auto second = registry.acquire("second.bin", GGML_FTYPE_ALL_F32, loader);
+        first.reset();
+        second.reset();
+        QVERIFY(freed.empty());
+
+        // the third model exceeds the budget - the least recently used idle one goes
+        auto third = registry.acquire("third.bin", GGML_FTYPE_ALL_F32, loader);
+        QCOMPARE(freed.size(), size_t(1));
+        QCOMPARE(freed.front(), fake_context(1));
+        QCOMPARE(registry.residentBytes(), qint64{ 200 });
+
+        // models in use are never evicted
+        registry.setMemoryBudget(0);
+        QCOMPARE(registry.residentModels(), 1);
+        QCOMPARE(freed.size(), size_t(2));
+    }
+
+    void failedLoad()
+    {
+        ModelRegistry registry{ 1000, [](whisper_context *){ } };
+        auto model = registry.acquire("missing.bin", GGML_FTYPE_ALL_F32, [](qint64&) -> whisper_context * {
+            return nullptr;
+        });
+        QVERIFY(!model);
+        QCOMPARE(registry.residentModels(), 0);
+    }
+
+    void notificationThread()
+    {
+        ModelRegistry registry{ 1000, [](whisper_context *){ } };
+        int notifications = 0;
+        QThread *notified = nullptr;
+        connect(&registry, &ModelRegistry::statsChanged, this, [&](){
+            notifications++;
+            notified = QThread::currentThread();
+        }, Qt::DirectConnection);
+
+        // acquired and released by a worker, like a backend does
+        std::thread worker{ [&](){
+            auto model = registry.acquire("model.bin", GGML_FTYPE_ALL_F32, [](qint64& size){
+                size = 100;
+                return fake_context(1);
+            });
+        } };
+        worker.join();
+        QCOMPARE(notifications, 0);
+        QTRY_VERIFY(notifications > 0);
+        QCOMPARE(notified, QThread::currentThread());
+    }
+};
+
+QTEST_MAIN(ModelRegistryTest)
+#include "tst_modelregistry.moc"
@@ -0,0 +1,77 @@
+#include <QTest>
+#include "PieceStitcher.h"
+
+class PieceStitcherTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void stitching()
+    {
+        PieceStitcher stitcher;
+        stitcher.dispatched(false);
+        stitcher.dispatched(true);
+
+        auto update = stitcher.result("one");
+        QCOMPARE(update.text, QString{ "one" });
+        QVERIFY(!update.final);
+        update = stitcher.result(" two");
+        QCOMPARE(update.text, QString{ "one two" });
+        QVERIFY(update.final);
+        QVERIFY(stitcher.stitched().isEmpty());
+
+        // results outside of an utterance, e.g. file transcription, pass through
+        update = stitcher.result("file");
+        QCOMPARE(update.text, QString{ "file" });
+        QVERIFY(update.final);
+    }
+
+    void stopWithPiecesInFlight()
+    {
+        PieceStitcher stitcher;
+        // split at a pause, then the capture stops before the speaker is done
+        stitcher.dispatched(false);
+        stitcher.dispatched(false);
+        QVERIFY(!stitcher.end().has_value());
+
+        QVERIFY(!stitcher.result("one").final);
+        const auto last = stitcher.result(" two");
+        QVERIFY(last.final);
+        QCOMPARE(last.text, QString{ "one two" });
+
+        // the next utterance does not carry the previous one along
+        stitcher.dispatched(true);
+        const auto next = stitcher.result("three");
+        QVERIFY(next.final);
+        QCOMPARE(next.text, QString{ "three" });
+    }
+
+    void stopAfterDecodedPieces()
+    {
+        PieceStitcher stitcher;
+        stitcher.dispatched(false);
+        QVERIFY(!stitcher.result("one").final);
+
+        // nothing in flight - the utterance is complete right away
+        QCOMPARE(stitcher.end(), std::optional<QString>{ "one" });
+        QVERIFY(stitcher.stitched().isEmpty());
+
+        stitcher.dispatched(true);
+        QCOMPARE(stitcher.result("two").text, QString{ "two" });
+    }
+
+    void clear()
+    {
+        PieceStitcher stitcher;
+        stitcher.dispatched(false);
+        QVERIFY(!stitcher.result("one").final);
+        stitcher.dispatched(true);
+        stitcher.clear();
+        QVERIFY(stitcher.stitched().isEmpty());
+        QCOMPARE(stitcher.end(), std::optional<QString>{ QString{ } });
+    }
+};
+
+QTEST_MAIN(PieceStitcherTest)
+#include "tst_piecestitcher.moc"
@@ -3,6 +3,8 @@
 #include "qbuffer.h"
 #include "ggml.h"
 #include <QDebug>
+#include <QThread>
+#include <QTemporaryFile>
 
 class QuantizerTest : public QObject
 {
@@ -72,6 +74,99 @@ private slots:
     {
         quantize(base_model_name,q80_model_name,GGML_FTYPE_MOSTLY_Q8_0);
     }
+    void inMemory()
+    {
+        // a QBuffer input is quantized in place - the result has to match the streamed one
+        QFile modelFile{ base_model_name };
+        modelFile.open(QIODeviceBase::ReadOnly);
+        const auto model = modelFile.readAll();
+        QBuffer input;
+        input.setData(model);
+        input.open(QIODeviceBase::ReadOnly);
+        QBuffer result;
+        result.open(QIODeviceBase::WriteOnly);
+        QCOMPARE(qtw::buffer_quantize(input, result, GGML_FTYPE_MOSTLY_Q5_1), 0);
+
+        QFile quantized{ q51_model_name };
+        quantized.open(QIODeviceBase::ReadOnly);
+        QCOMPARE(result.buffer(), quantized.readAll());
+    }
+    void truncated_data()
+    {
+        QTest::addColumn<bool>("inMemory");
+        QTest::newRow("mapped") << true;
+        QTest::newRow("streamed") << false;
+    }
+    void truncated()
+    {
+        QFETCH(bool, inMemory);
+        QFile modelFile{ base_model_name };
+        modelFile.open(QIODeviceBase::ReadOnly);
+        // cut in the middle of a tensor
+        const auto model = modelFile.read(modelFile.size() / 2);
+
+        QBuffer buffer;
+        QTemporaryFile file;
+        QIODevice *input = &buffer;
+        if (inMemory) {
+            buffer.setData(model);
+            buffer.open(QIODeviceBase::ReadOnly);
+        } else {
+            QVERIFY(file.open());
+            file.write(model);
+            file.seek(0);
+            input = &file;
+        }
+        QBuffer result;
+        result.open(QIODeviceBase::WriteOnly);
+        QCOMPARE(qtw::buffer_quantize(*input, result, GGML_FTYPE_MOSTLY_Q5_1), qtw::Quantizer::TRUNCATED_INPUT);
+        QVERIFY(result.size() < model.size());
+    }
+    void cancel()
+    {
+        QFile modelFile{ base_model_name };
+        modelFile.open(QIODeviceBase::ReadOnly);
+        std::atomic<quint64> generation{ 0 };
+        qtw::Quantizer quantizer{ modelFile, GGML_FTYPE_MOSTLY_Q4_0 };
+        quantizer.setCancelToken(CancelToken{ &generation, 0 });
+
+        // the preamble is produced before the first checkpoint
+        QVERIFY(!quantizer.next().isEmpty());
+        generation++;
+        QVERIFY(quantizer.next().isEmpty());
+        QVERIFY(quantizer.atEnd());
+        QCOMPARE(quantizer.error(), qtw::Quantizer::CANCELLED);
+    }
+
+    void cancelInFlight()
+    {
+        QFile modelFile{ base_model_name };
+        modelFile.open(QIODeviceBase::ReadOnly);
+        QFile reference{ q40_model_name };
+        reference.open(QIODeviceBase::ReadOnly);
+        const auto ref = reference.readAll();
+
+        // the only worker is busy until the cancel - the tensors queued behind it are skipped
+        QThreadPool pool;
+        pool.setMaxThreadCount(1);
+        std::atomic<quint64> generation{ 0 };
+        pool.start([&](){
+            QThread::msleep(50);
+            generation++;
+        });
+        qtw::Quantizer quantizer{ modelFile, GGML_FTYPE_MOSTLY_Q4_0, &pool };
+        quantizer.setCancelToken(CancelToken{ &generation, 0 });
+
+        QByteArray result;
+        for (auto chunk = quantizer.next(); !chunk.isEmpty(); chunk = quantizer.next()) {
+            result.append(chunk);
+        }
+        pool.waitForDone();
+        QCOMPARE(quantizer.error(), qtw::Quantizer::CANCELLED);
+        // whatever was handed out before the cancel is valid - never a skipped tensor
+        QVERIFY(result.size() < ref.size());
+        QVERIFY(ref.startsWith(result));
+    }
 };
 
 QTEST_MAIN(QuantizerTest)
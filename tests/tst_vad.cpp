@@ -0,0 +1,139 @@
+#include <QTest>
+#include <QSignalSpy>
+#include <cmath>
+#include <numbers>
+#include "VoiceActivityDetector.h"
+
+namespace {
+/// Quiet noise, a second of a 440 Hz tone and quiet noise again
+std::vector<float> utterance()
+{
+    std::vector<float> samples;
+    quint32 seed = 7;
+    auto noise = [&](){
+        seed = seed * 1664525u + 1013904223u;
+        return (static_cast<float>(seed >> 8) / (1 << 24) - 0.5f) * 0.001f;
+    };
+    for (int i = 0; i < 16000; i++) {
+        samples.push_back(noise());
+    }
+    for (int i = 0; i < 16000; i++) {
+        samples.push_back(0.3f * static_cast<float>(std::sin(2 * std::numbers::pi * 440 * i / 16000)) + noise());
+    }
+    for (int i = 0; i < 32000; i++) {
+        samples.push_back(noise());
+    }
+    return samples;
+}
+
+/// Tone for \a ms milliseconds followed by quiet noise for \a pauseMs
+void append_tone(std::vector<float>& samples, int ms, int pauseMs)
+{
+    for (int i = 0; i < ms * 16; i++) {
+        samples.push_back(0.3f * static_cast<float>(std::sin(2 * std::numbers::pi * 440 * i / 16000)));
+    }
+    samples.insert(samples.end(), pauseMs * 16, 0.0001f);
+}
+
+VoiceActivityDetector::Params testParams()
+{
+    auto params = VoiceActivityDetector::defaultParams();
+    params.adjust_samples  = 20;
+    params.patience        = 20;
+    params.minimum_samples = 10;
+    return params;
+}
+} // namespace
+
+class VadTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void chunkSizeIndependence_data()
+    {
+        QTest::addColumn<int>("chunk");
+        QTest::newRow("one sample") << 1;
+        QTest::newRow("partial frame") << 100;
+        QTest::newRow("frame") << static_cast<int>(VadEngine::FRAME_SAMPLES);
+        QTest::newRow("capture callback") << 4410;
+    }
+
+    void chunkSizeIndependence()
+    {
+        QFETCH(int, chunk);
+        const auto samples = utterance();
+
+        VoiceActivityDetector vad{ testParams() };
+        QSignalSpy spy{ &vad, &VoiceActivityDetector::speechDetected };
+        for (size_t offset = 0; offset < samples.size(); offset += chunk) {
+            vad.feedSamples(std::span{ samples }.subspan(offset, std::min<size_t>(chunk, samples.size() - offset)));
+        }
+
+        // the same frames are seen whatever the chunking - the segment is always the same
+        QCOMPARE(spy.count(), 1);
+        const auto segment = spy.takeFirst().at(0).value<AudioBuffer>();
+        QCOMPARE(segment.size() % VadEngine::FRAME_SAMPLES, size_t(0));
+        QVERIFY(segment.size() >= 16000);
+        QVERIFY(segment.size() <= 16000 + (testParams().patience + 2) * VadEngine::FRAME_SAMPLES);
+    }
+
+    void flush()
+    {
+        const auto samples = utterance();
+        VoiceActivityDetector vad{ testParams() };
+        QSignalSpy spy{ &vad, &VoiceActivityDetector::speechDetected };
+
+        // end of input in the middle of the speech
+        vad.feedSamples(std::span{ samples }.first(24000));
+        QVERIFY(vad.getVoiceInProgress());
+        QCOMPARE(spy.count(), 0);
+        vad.flush();
+        QCOMPARE(spy.count(), 1);
+        QVERIFY(!vad.getVoiceInProgress());
+    }
+
+    void splitAtPause()
+    {
+        auto params        = testParams();
+        params.split_after = 50;
+        params.split_pause = 5;
+        std::vector<float> samples(16000, 0.0001f);
+        append_tone(samples, 1500, 150);
+        append_tone(samples, 500, 1000);
+
+        VoiceActivityDetector vad{ params };
+        QSignalSpy chunks{ &vad, &VoiceActivityDetector::speechChunkDetected };
+        QSignalSpy ends{ &vad, &VoiceActivityDetector::speechDetected };
+        vad.feedSamples(samples);
+
+        // the first piece ends in the pause, the rest comes with the end of speech
+        QCOMPARE(chunks.count(), 1);
+        QCOMPARE(ends.count(), 1);
+        const auto first = chunks.takeFirst().at(0).value<AudioBuffer>();
+        QVERIFY(first.size() >= 24000);
+        QVERIFY(first.size() < 24000 + 150 * 16);
+        QVERIFY(!ends.takeFirst().at(0).value<AudioBuffer>().isNull());
+    }
+
+    void hardCap()
+    {
+        auto params        = testParams();
+        params.max_segment = 100;
+        std::vector<float> samples(16000, 0.0001f);
+        append_tone(samples, 5000, 1000);
+
+        VoiceActivityDetector vad{ params };
+        QSignalSpy chunks{ &vad, &VoiceActivityDetector::speechChunkDetected };
+        vad.feedSamples(samples);
+
+        QVERIFY(chunks.count() >= 2);
+        for (const auto& chunk : chunks) {
+            QCOMPARE(chunk.at(0).value<AudioBuffer>().size(), 100 * VadEngine::FRAME_SAMPLES);
+        }
+    }
+};
+
+QTEST_MAIN(VadTest)
+#include "tst_vad.moc"
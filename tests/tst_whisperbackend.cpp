@@ -0,0 +1,164 @@
+#include <QTest>
+#include <QSignalSpy>
+#include <QRandomGenerator>
+#include <map>
+#include "WhisperBackend.h"
+#include "WavDecoder.h"
+#include "AudioConverter.h"
+
+class WhisperBackendTest : public QObject
+{
+    Q_OBJECT
+    const char *model_name = "ggml-tiny.bin";
+
+    /// A second of quiet noise - long enough for a decode to still be running when it is cancelled
+    static AudioBuffer utterance()
+    {
+        auto samples = AudioPool::shared().acquire();
+        auto out     = samples.grow(WHISPER_SAMPLE_RATE);
+        QRandomGenerator rng{ 42 };
+        for (auto& s : out) {
+            s = static_cast<float>(rng.generateDouble() * 0.02 - 0.01);
+        }
+        return samples;
+    }
+
+    /// The speech sample shipped with whisper.cpp
+    static AudioBuffer speech()
+    {
+        QFile file{ SPEECH_SAMPLE };
+        WavDecoder decoder{ file };
+        if (!file.open(QIODeviceBase::ReadOnly) || !decoder.open()) {
+            return AudioBuffer{ };
+        }
+        AudioConverter converter{ decoder.format(), WHISPER_SAMPLE_RATE };
+        auto samples = AudioPool::shared().acquire();
+        QByteArray chunk{ 1 << 16, Qt::Uninitialized };
+        for (qint64 n; (n = decoder.read(chunk.data(), chunk.size())) > 0;) {
+            const auto before = samples.size();
+            const auto out    = samples.grow(converter.maxOutput(n));
+            samples.resize(before + converter.convert({ chunk.constData(), static_cast<size_t>(n) }, out));
+        }
+        return samples;
+    }
+
+private slots:
+
+    void initTestCase()
+    {
+        QVERIFY(QFileInfo{ model_name }.size() > 0);
+    }
+
+    void cancelReportsEveryUtterance()
+    {
+        WhisperBackend backend{ model_name };
+        backend.setNumWorkers(1);
+        QSignalSpy loaded{ &backend, &WhisperBackend::modelLoaded };
+        backend.loadModel();
+        QCOMPARE(loaded.count(), 1);
+
+        QSignalSpy results{ &backend, &WhisperBackend::resultReady };
+        for (int i = 0; i < 3; i++) {
+            backend.threadedInference(utterance());
+        }
+        // the running decode is interrupted and the queued ones never start - the unload drops
+        // the pool with their completions, which still have to be reported
+        backend.cancel();
+        backend.unloadModel();
+        QCOMPARE(results.count(), 3);
+
+        // the first utterance after the model switch gets its own result
+        QCoreApplication::processEvents();
+        backend.loadModel();
+        QCOMPARE(loaded.count(), 2);
+        backend.threadedInference(utterance());
+        QTRY_COMPARE_WITH_TIMEOUT(results.count(), 4, 30000);
+    }
+
+    void finishedDecodeSurvivesPool()
+    {
+        const auto samples = speech();
+        QVERIFY(!samples.empty());
+        auto ctx = whisper_init_from_file_no_state(model_name);
+        QVERIFY(ctx);
+
+        QStringList results;
+        {
+            InferencePool pool{ ctx, 1 };
+            connect(&pool, &InferencePool::resultReady, this, [&](quint64, QString text){
+                results.append(text);
+            });
+            pool.submit(samples, whisper_full_default_params(WHISPER_SAMPLING_GREEDY));
+            // the decode finishes, its completion is still queued when the pool goes away
+            pool.waitForWarmUp();
+            QVERIFY(results.isEmpty());
+        }
+        QCOMPARE(results.size(), 1);
+        QVERIFY(!results.first().isEmpty());
+        whisper_free(ctx);
+    }
+
+    void segmentsCarryTheirUtterance()
+    {
+        const auto samples = speech();
+        QVERIFY(!samples.empty());
+
+        WhisperBackend backend{ model_name };
+        backend.setNumWorkers(2);
+        backend.loadModel();
+
+        // both utterances are decoded at once - their segments interleave
+        std::map<quint64, int> segments;
+        quint64 reported = 0;
+        bool late = false;
+        connect(&backend, &WhisperBackend::segmentReady, this, [&](quint64 utterance){
+            segments[utterance]++;
+            late |= utterance < reported;
+        });
+        connect(&backend, &WhisperBackend::resultReady, this, [&](){
+            reported++;
+        });
+        backend.threadedInference(samples);
+        backend.threadedInference(samples);
+        QTRY_COMPARE_WITH_TIMEOUT(reported, quint64{ 2 }, 60000);
+
+        QCOMPARE(segments.size(), size_t{ 2 });
+        QVERIFY(segments.contains(0) && segments.contains(1));
+        // every segment precedes the result of its utterance
+        QVERIFY(!late);
+
+        // the numbering goes on across a reload of the model
+        segments.clear();
+        backend.unloadModel();
+        backend.loadModel();
+        backend.threadedInference(samples);
+        QTRY_COMPARE_WITH_TIMEOUT(reported, quint64{ 3 }, 60000);
+        QCOMPARE(segments.size(), size_t{ 1 });
+        QVERIFY(segments.contains(2));
+    }
+
+    void failedLoad()
+    {
+        WhisperBackend backend{ "missing-model.bin" };
+        QSignalSpy errors{ &backend, &WhisperBackend::error };
+        QSignalSpy loaded{ &backend, &WhisperBackend::modelLoaded };
+        backend.loadModel();
+        QCOMPARE(errors.count(), 1);
+        QCOMPARE(loaded.count(), 0);
+        QVERIFY(!backend.getBusy());
+    }
+
+    void noModel()
+    {
+        WhisperBackend backend{ model_name };
+        QSignalSpy results{ &backend, &WhisperBackend::resultReady };
+        QSignalSpy errors{ &backend, &WhisperBackend::error };
+        backend.threadedInference(utterance());
+        QCOMPARE(errors.count(), 1);
+        QCOMPARE(results.count(), 1);
+        QVERIFY(results.first().first().toString().isEmpty());
+    }
+};
+
+QTEST_MAIN(WhisperBackendTest)
+#include "tst_whisperbackend.moc"
@@ -0,0 +1,97 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <cstdio>
+
+#include "private/quantization.h"
+
+static ggml_ftype parseType(const QString& name)
+{
+    static const QHash<QString, ggml_ftype> types = {
+        { "q4_0", GGML_FTYPE_MOSTLY_Q4_0 },
+        { "q4_1", GGML_FTYPE_MOSTLY_Q4_1 },
+        { "q5_0", GGML_FTYPE_MOSTLY_Q5_0 },
+        { "q5_1", GGML_FTYPE_MOSTLY_Q5_1 },
+        { "q8_0", GGML_FTYPE_MOSTLY_Q8_0 },
+    };
+    return types.value(name.toLower(), GGML_FTYPE_UNKNOWN);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qt-whisper-quantize");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Quantizes a ggml whisper model - the same conversion qt-whisper runs when loading");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "F32 or F16 ggml whisper model");
+    parser.addPositionalArgument("output", "Path of the quantized model");
+    parser.addPositionalArgument("type", "Quantization type: q4_0, q4_1, q5_0, q5_1 or q8_0");
+    QCommandLineOption threadsOption{ "threads", "Threads quantizing tensors (all cores by default)", "n",
+                                      QString::number(QThread::idealThreadCount()) };
+    QCommandLineOption quietOption{ "quiet", "Do not report progress" };
+    parser.addOptions({ threadsOption, quietOption });
+    parser.process(app);
+
+    const auto args = parser.positionalArguments();
+    if (args.size() != 3) {
+        parser.showHelp(1);
+    }
+    const auto ftype = parseType(args[2]);
+    if (ftype == GGML_FTYPE_UNKNOWN) {
+        fprintf(stderr, "Unknown quantization type: %s\n", qPrintable(args[2]));
+        return 1;
+    }
+
+    QFile input{ args[0] };
+    if (!input.open(QIODeviceBase::ReadOnly)) {
+        fprintf(stderr, "Failed to open %s: %s\n", qPrintable(args[0]), qPrintable(input.errorString()));
+        return 1;
+    }
+    // written to a temporary file and renamed at the end - a failed run never leaves a partial model behind
+    QSaveFile output{ args[1] };
+    if (!output.open(QIODeviceBase::WriteOnly)) {
+        fprintf(stderr, "Failed to open %s: %s\n", qPrintable(args[1]), qPrintable(output.errorString()));
+        return 1;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(std::max(1, parser.value(threadsOption).toInt()));
+    const bool quiet = parser.isSet(quietOption);
+    int reported     = -1;
+    auto progress    = [&](double fraction){
+        const int percent = static_cast<int>(fraction * 100);
+        if (!quiet && percent != reported) {
+            reported = percent;
+            fprintf(stderr, "\rQuantizing %s: %3d%%", qPrintable(args[0]), percent);
+            fflush(stderr);
+        }
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    const auto error = qtw::buffer_quantize(input, output, ftype, &pool, nullptr, CancelToken{ }, progress);
+    if (!quiet) {
+        fprintf(stderr, "\n");
+    }
+    if (error != 0) {
+        fprintf(stderr, "Quantization failed with code %d\n", error);
+        return 2;
+    }
+    if (!output.commit()) {
+        fprintf(stderr, "Failed to write %s: %s\n", qPrintable(args[1]), qPrintable(output.errorString()));
+        return 1;
+    }
+    if (!quiet) {
+        fprintf(stderr, "%s: %lld MiB -> %lld MiB in %lld ms on %d threads\n", qPrintable(args[1]), input.size() >> 20,
+                QFile{ args[1] }.size() >> 20, timer.elapsed(), pool.maxThreadCount());
+    }
+    return 0;
+}